@@ -40,6 +40,9 @@ function set_up_emitter() {
 
 		// Send data to Main (and from there to other renderer windows)
 		ipc.send(IPCMessages.UPDATE.NEWFRAME, centroid_results);
+
+		// The preview was copied into the message, so its buffer can be filled with a later preview
+		if (centroid_results.image_buffer) camera.returnPreview(centroid_results.image_buffer);
 	});
 
 	// Initialize emitter on C++ side
@@ -83,6 +86,13 @@ function open_camera() {
 function apply_camera_settings() {
 	let C = settings.camera; // Camera settings
 
+	// Bit depth of camera images, needs to be set before the color mode and image memory are
+	// (Once image memory is allocated, a new bit depth only takes effect after the camera is reconnected)
+	camera.setBitDepth(C.bit_depth);
+
+	// Number of image memories the camera writes frames into in turn, also needs to be set before image memory is allocated
+	camera.setFrameBufferCount(C.frame_buffer_count);
+
 	// Apply default camera settings (the ones that I don't think need to be adjustable in Hyperion settings)
 	// These include: Color mode, Display mode, and memory allocation
 	camera.applyDefaultSettings();
@@ -111,6 +121,16 @@ function apply_camera_settings() {
 
 	// Whether to use Hybrid centroiding method (HGCM) or just CoM method
 	camera.useHybridMethod(settings.centroid.use_hybrid_method);
+
+	// Whether to label regions from runs of lit pixels (faster on sparse frames, same centroids)
+	camera.useRunLengthLabeling(settings.centroid.use_run_length_labeling);
+
+	// Number of threads to split each image between (each labels its own horizontal strip)
+	camera.setCentroidThreads(settings.centroid.thread_count);
+
+	// Live view images are made separately from centroiding, at most preview_rate per second and downscaled by preview_scale
+	camera.setPreviewRate(C.preview_rate);
+	camera.setPreviewScale(C.preview_scale);
 }
 
 // Start image capture and processing
@@ -119,7 +139,11 @@ function start_image_capture() {
 	camera.startCapture();
 
 	// Start processing images
-	if (camera.enableMessages()) {
+	// (Frames are centroided on a C++ thread and results arrive through the emitter,
+	//	falling back to checking for messages from JS if that can't be started)
+	if (camera.startAcquisition()) {
+		console.log("Acquisition thread started!");
+	} else if (camera.enableMessages()) {
 		console.log("Messages enabled!");
 		check_messages = true;
 		message_loop();
@@ -149,6 +173,7 @@ function message_loop() {
 }
 
 // End message loop and close the camera
+// (Closing the camera also stops the acquisition thread)
 function close_camera() {
 	check_messages = false;
 	camera.close(); // Error codes will be printed to terminal on C++ side
@@ -179,3 +204,13 @@ ipc.on(IPCMessages.UPDATE.CLOSECAMERA, function (event, message) {
 ipc.on(IPCMessages.CONNECT.CAMERA, () => {
 	open_camera();
 });
+
+// Only make live view images while the Live View window is open
+ipc.on(IPCMessages.UPDATE.LIVEVIEWOPEN, (event, is_open) => {
+	camera.setPreviewEnabled(is_open);
+});
+
+// Send a full size image with the next frame (for saving a single shot)
+ipc.on(IPCMessages.UPDATE.FULLIMAGE, () => {
+	camera.requestFullImage();
+});
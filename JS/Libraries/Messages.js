@@ -19,6 +19,8 @@ const IPCMessages = {
 		CAMERACLOSED: "IPC-CAMERA-CLOSED",
 		CAMERAERROR: "IPC-CAMERA-ERROR",
 		SAVEDIRECTORY: "IPC-UPDATE-SAVE-DIR",
+		LIVEVIEWOPEN: "IPC-LIVE-VIEW-OPEN",
+		FULLIMAGE: "IPC-REQUEST-FULL-IMAGE",
 	},
 	CONNECT: {
 		CAMERA: "IPC-OPEN-CAMERA",
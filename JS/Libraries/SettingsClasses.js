@@ -58,6 +58,10 @@ class Settings {
 			gain: 0,
 			gain_boost: false,
 			trigger: TriggerDetection.RISING_EDGE.state,
+			bit_depth: 8, // Bits per pixel (8 - Mono8, 10/12/16 - Mono10/12/16)
+			frame_buffer_count: 4, // Image memories the camera writes frames into in turn (at least 2)
+			preview_rate: 10, // Most live view images per second (0 - every frame)
+			preview_scale: 1, // Live view image downscaling (1, 2 or 4 camera pixels per shown pixel, each way)
 			LED_area: {
 				x_start: 0,
 				x_end: 100,
@@ -74,7 +78,10 @@ class Settings {
 
 		this.centroid = {
 			use_hybrid_method: true,
+			use_run_length_labeling: false, // Whether to label runs of lit pixels instead of single pixels
+			thread_count: 1, // Number of threads used to centroid each image
 			bin_size: BinSize.REGULAR.size,
+			image_mapping: "linear", // How electron counts are shown on accumulated image displays ("linear", "sqrt" or "log")
 		};
 
 		this.detachment_laser = {
@@ -65,26 +65,22 @@ function UpdateAverageDisplays() {
 // Receive message with centroid data
 ipc.on(IPCMessages.UPDATE.NEWFRAME, function (event, centroid_results) {
 	// centroid_results is an object containing:
-	//		image_buffer			-	Uint8Buffer - Current image frame
-	// 		com_centers				-	Array		- Center of Mass centroids
-	//		hgcm_centers			-	Array		- HGCM method centroids
+	//		image_buffer			-	Uint8Buffer - Live view image (RGBA), only on frames one was made of
+	//		preview_width			-	Number		- Width of the live view image
+	//		preview_height			-	Number		- Height of the live view image
+	//		preview_scale			-	Number		- Camera pixels per live view image pixel, each way
+	// 		com_centers				-	Float32Array	- Center of Mass centroids (X, Y, intensity of each)
+	//		hgcm_centers			-	Float32Array	- HGCM method centroids (same)
+	//		com_count				-	Number		- Number of CoM centroids
+	//		hgcm_count				-	Number		- Number of HGCM centroids
 	//		computation_time		-	Float		- Time to calculate centroids (ms)
 	//		is_led_on				- 	Boolean		- Whether IR LED was on in image
 	//		avg_led_intensity		-	Float		- Average intensity of pixels in LED region
 	//		avg_noise_intensity		-	Float		- Average intensity of pixels in noise region
 
-	// Temp variables for image and AoI size
-	let imageWidth = 1024;
-	let imageHeight = 768;
-	let xOffset = 100;
-	let yOffset = 0;
-
-	const LiveViewContext = document.getElementById("LiveVideoView").getContext("2d");
-	let LVData = new ImageData(imageWidth, imageHeight);
-
 	// Put image on display
-	LVData.data.set(centroid_results.image_buffer);
-	LiveViewContext.putImageData(LVData, -xOffset, -yOffset);
+	// (Live view images are rate limited, so most frames don't have one)
+	if (centroid_results.image_buffer) show_image(centroid_results);
 
 	// Add counts to chart
 	eChartData.updateData(centroid_results);
@@ -96,6 +92,32 @@ ipc.on(IPCMessages.UPDATE.NEWFRAME, function (event, centroid_results) {
 	UpdateAverageDisplays();
 });
 
+// Temp variables for AoI offset (camera pixels)
+const xOffset = 100;
+const yOffset = 0;
+const ScaledImageCanvas = document.createElement("canvas"); // Downscaled live view image, before it's drawn at camera size
+
+function show_image(centroid_results) {
+	const LiveViewContext = document.getElementById("LiveVideoView").getContext("2d");
+	let { preview_width, preview_height, preview_scale } = centroid_results;
+	let LVData = new ImageData(preview_width, preview_height);
+	LVData.data.set(centroid_results.image_buffer);
+
+	if (preview_scale === 1) {
+		LiveViewContext.putImageData(LVData, -xOffset, -yOffset);
+		return;
+	}
+
+	// Downscaled images are drawn back at camera size
+	// (drawImage() blends with what's already there, so the old image is cleared first)
+	if (ScaledImageCanvas.width !== preview_width) ScaledImageCanvas.width = preview_width;
+	if (ScaledImageCanvas.height !== preview_height) ScaledImageCanvas.height = preview_height;
+	ScaledImageCanvas.getContext("2d").putImageData(LVData, 0, 0);
+	LiveViewContext.imageSmoothingEnabled = false;
+	LiveViewContext.clearRect(0, 0, LiveViewContext.canvas.width, LiveViewContext.canvas.height);
+	LiveViewContext.drawImage(ScaledImageCanvas, -xOffset, -yOffset, preview_scale * preview_width, preview_scale * preview_height);
+}
+
 const eChart = new Chart(document.getElementById("eChart").getContext("2d"), {
 	type: "line",
 	data: {
@@ -158,8 +180,8 @@ const eChartData = {
 	},
 	updateData: function (centroid_results) {
 		this.labels.push(this.frameCount);
-		this.comData.push(centroid_results.com_centers.length);
-		this.hgcmData.push(centroid_results.com_centers.length + centroid_results.hgcm_centers.length);
+		this.comData.push(centroid_results.com_count);
+		this.hgcmData.push(centroid_results.com_count + centroid_results.hgcm_count);
 		this.frameCount++;
 		this.cleaveData();
 	},
@@ -178,8 +200,8 @@ const eChartData = {
 	},
 
 	updateDataMini: function (centroid_results) {
-		this.comDataMini.push(centroid_results.com_centers.length);
-		this.hgcmDataMini.push(centroid_results.hgcm_centers.length + centroid_results.com_centers.length);
+		this.comDataMini.push(centroid_results.com_count);
+		this.hgcmDataMini.push(centroid_results.hgcm_count + centroid_results.com_count);
 
 		if (this.comDataMini.length > 20) {
 			const com_sum = this.comDataMini.reduce((accumulator, currentValue) => accumulator + currentValue, 0);
@@ -228,8 +250,8 @@ const averageCount = {
 	// been processed since the last time avg display was updated
 	updateFrequency: 10, // Number of frames before updating display
 	update: function (centroid_results) {
-		let com = centroid_results.com_centers.length;
-		let hgcm = centroid_results.hgcm_centers.length;
+		let com = centroid_results.com_count;
+		let hgcm = centroid_results.hgcm_count;
 		let total = com + hgcm;
 		// Add to respective arrays
 		this.prevCOMCounts.push(com);
@@ -2,6 +2,7 @@ const { DetachmentWavelength, ExcitationWavelength, DetachmentMode, ExcitationMo
 const { WavemeterMeasurement } = require("./WavemeterClasses.js");
 const { PESpectrum, IRPESpectrum } = require("./PESpectrumClasses.js");
 const { UpdateMessenger } = require("../Managers/UpdateMessenger.js");
+const camera = require("bindings")("camera"); // Only used to bin centroids into accumulated images and render them
 
 // Messenger used for displaying update or error messages to the Message Display
 const update_messenger = new UpdateMessenger();
@@ -149,13 +150,15 @@ class Image {
 	/**
 	 * Update electron and frame counts
 	 * @param {Object} centroid_results Elements:
-	 * 		com_centers: Array of centroids found with CoM method, elements as [X, Y],
-	 * 		hgcm_centers: Array of centroids found with HGCM method, elements as [X, Y],
+	 * 		com_centers: Float32Array of centroids found with CoM method, packed as X, Y, intensity of each,
+	 * 		hgcm_centers: Float32Array of centroids found with HGCM method, packed the same way,
+	 * 		com_count: Number of CoM centroids,
+	 * 		hgcm_count: Number of HGCM centroids,
 	 * 		is_led_on: Boolean, whether IR LED is on in camera frame
 	 */
 	update_counts(centroid_results) {
-		let com_count = centroid_results.com_centers.length;
-		let hgcm_count = centroid_results.hgcm_centers.length;
+		let com_count = centroid_results.com_count;
+		let hgcm_count = centroid_results.hgcm_count;
 		let total_count = com_count + hgcm_count;
 
 		if (centroid_results.is_led_on) {
@@ -190,14 +193,12 @@ class Image {
 	/**
 	 * Added centroided electrons to accumulated image
 	 * @param {Object} centroid_results Elements:
-	 * 		com_centers: Array of centroids found with CoM method, elements as [X, Y],
-	 * 		hgcm_centers: Array of centroids found with HGCM method, elements as [X, Y],
+	 * 		centroids: Float32Array of every centroid (both methods), packed as in node_addons/include/resultqueue.h,
 	 * 		is_led_on: Boolean, whether IR LED is on in camera frame
 	 */
 	update_image(centroid_results) {
-		// Update image with electrons
-		Image_update_image(this.image, centroid_results.com_centers, undefined, this.bin_size); // CoM Centroids
-		Image_update_image(this.image, centroid_results.hgcm_centers, undefined, this.bin_size); // HGCM Centroids
+		// Update image with electrons (CoM and HGCM centroids)
+		Image_update_image(this.image, centroid_results.centroids, this.bin_size);
 	}
 
 	/**
@@ -205,7 +206,8 @@ class Image {
 	 */
 	reset_image() {
 		let bin_size = this.bin_size;
-		this.image = Array.from(Array(bin_size), () => new Array(bin_size).fill(0));
+		// Accumulated image is bin_size x bin_size electron counts, row by row
+		this.image = new Uint32Array(bin_size * bin_size);
 	}
 
 	/**
@@ -213,7 +215,7 @@ class Image {
 	 */
 	delete_image() {
 		// In order to save memory, delete the accumulated image when scan is complete
-		this.image = [[]];
+		this.image = new Uint32Array(0);
 	}
 
 	/**
@@ -230,7 +232,7 @@ class Image {
 
 		let file_name = path.join(Image.save_directory, this.file_name);
 		// Convert image to string
-		let image_string = this.image.map((row) => row.join(" ")).join("\n");
+		let image_string = Image_to_string(this.image, this.bin_size);
 		// Save image to file and send update on completion
 		fs.writeFile(file_name, image_string, (error) => {
 			if (error) {
@@ -246,11 +248,12 @@ class Image {
 	 * Get ImageData object with the desired image data, scaled to the desired contrast
 	 * @param {ImageType} which_image - which image to return
 	 * @param {number} contrast ranges from 0 to 1
+	 * @param {string} mapping how counts are mapped to gray levels ("linear", "sqrt" or "log")
 	 * @returns {ImageData} selected image converted to ImageData object
 	 */
-	get_image_display(which_image, contrast) {
+	get_image_display(which_image, contrast, mapping) {
 		// For the Image class, there is only one image to return so which_image is ignored
-		return Image_get_image_display(this.image, contrast);
+		return Image_get_image_display(this.image, this.bin_size, contrast, mapping);
 	}
 
 	/**
@@ -283,8 +286,9 @@ class Image {
 			if (error) console.log(error);
 			else if (data) {
 				data = data.toString();
-				this.image = data.split(" \n").map((row) => row.split(" ").map((el) => parseInt(el)));
-				this.image.pop();
+				let rows = data.split(" \n").map((row) => row.split(" ").map((el) => parseInt(el)));
+				rows.pop();
+				this.image = Image_from_rows(rows, this.bin_size);
 			}
 		});
 	}
@@ -308,25 +312,14 @@ class IRImage extends Image {
 	/**
 	 * Added centroided electrons to accumulated images
 	 * @param {Object} centroid_results Elements:
-	 * 		com_centers: Array of centroids found with CoM method, elements as [X, Y],
-	 * 		hgcm_centers: Array of centroids found with HGCM method, elements as [X, Y],
+	 * 		centroids: Float32Array of every centroid (both methods), packed as in node_addons/include/resultqueue.h,
 	 * 		is_led_on: Boolean, whether IR LED is on in camera frame
 	 */
 	update_image(centroid_results) {
-		let image_to_update, difference_increment;
 		// Figure out whether to add to IR Off or IR On image
-		if (centroid_results.is_led_on) {
-			// IR On
-			image_to_update = this.images.ir_on;
-			difference_increment = 1;
-		} else {
-			// IR Off
-			image_to_update = this.images.ir_off;
-			difference_increment = -1;
-		}
-		// Update image with electrons
-		Image_update_image(image_to_update, centroid_results.com_centers, this.images.difference, this.bin_size, difference_increment); // CoM Centroids
-		Image_update_image(image_to_update, centroid_results.hgcm_centers, this.images.difference, this.bin_size, difference_increment); // HGCM Centroids
+		let image_to_update = centroid_results.is_led_on ? this.images.ir_on : this.images.ir_off;
+		// Update image with electrons (CoM and HGCM centroids)
+		Image_update_image(image_to_update, centroid_results.centroids, this.bin_size);
 	}
 
 	/**
@@ -334,10 +327,11 @@ class IRImage extends Image {
 	 */
 	reset_image() {
 		let bin_size = this.bin_size;
+		// Accumulated images are bin_size x bin_size electron counts, row by row
+		// (The difference image is IR On - IR Off, worked out when it's displayed)
 		this.images = {};
-		this.images.ir_off = Array.from(Array(bin_size), () => new Array(bin_size).fill(0));
-		this.images.ir_on = Array.from(Array(bin_size), () => new Array(bin_size).fill(0));
-		this.images.difference = Array.from(Array(bin_size), () => new Array(bin_size).fill(0));
+		this.images.ir_off = new Uint32Array(bin_size * bin_size);
+		this.images.ir_on = new Uint32Array(bin_size * bin_size);
 	}
 
 	/**
@@ -345,9 +339,8 @@ class IRImage extends Image {
 	 */
 	delete_image() {
 		// In order to save memory, delete the accumulated image when scan is complete
-		this.images.ir_off = [[]];
-		this.images.ir_on = [[]];
-		this.images.difference = [[]];
+		this.images.ir_off = new Uint32Array(0);
+		this.images.ir_on = new Uint32Array(0);
 	}
 
 	/**
@@ -365,8 +358,8 @@ class IRImage extends Image {
 		let file_name = path.join(Image.save_directory, this.file_name);
 		let file_name_ir = path.join(Image.save_directory, this.file_name_ir);
 		// Convert images to string
-		let image_string = this.images.ir_off.map((row) => row.join(" ")).join("\n");
-		let image_string_ir = this.images.ir_on.map((row) => row.join(" ")).join("\n");
+		let image_string = Image_to_string(this.images.ir_off, this.bin_size);
+		let image_string_ir = Image_to_string(this.images.ir_on, this.bin_size);
 		// Save images to file and send updates on completion
 		fs.writeFile(file_name, image_string, (error) => {
 			if (error) {
@@ -390,18 +383,19 @@ class IRImage extends Image {
 	 * Get ImageData object with the desired image data, scaled to the desired contrast
 	 * @param {ImageType} which_image - which image to return
 	 * @param {number} contrast ranges from 0 to 1
+	 * @param {string} mapping how counts are mapped to gray levels ("linear", "sqrt" or "log")
 	 * @returns {ImageData} selected image converted to ImageData object
 	 */
-	get_image_display(which_image, contrast) {
+	get_image_display(which_image, contrast, mapping) {
 		switch (which_image) {
 			case ImageType.IROFF:
-				return Image_get_image_display(this.images.ir_off, contrast);
+				return Image_get_image_display(this.images.ir_off, this.bin_size, contrast, mapping);
 			case ImageType.IRON:
-				return Image_get_image_display(this.images.ir_on, contrast);
+				return Image_get_image_display(this.images.ir_on, this.bin_size, contrast, mapping);
 			case ImageType.DIFFPOS:
-				return Image_get_image_display(this.images.difference, contrast);
+				return Image_get_image_display(this.images.ir_on, this.bin_size, contrast, mapping, false, this.images.ir_off);
 			case ImageType.DIFFNEG:
-				return Image_get_image_display(this.images.difference, contrast, true);
+				return Image_get_image_display(this.images.ir_on, this.bin_size, contrast, mapping, true, this.images.ir_off);
 		}
 	}
 
@@ -443,63 +437,75 @@ class EmptyIRImage extends IRImage {
 ***/
 
 /**
- * Take in array with centroids (centers) and add to accumulated image (image)
- * Optionally, add centroids to difference image (difference_image)
- * @param {Array} image accumulated image - 2D array to add centroids to
- * @param {Array} centers array of centroid positions [[X,Y],...]
- * @param {Array} difference_image difference accumulated image - 2D array
+ * Take in packed centroids (both methods) and add them to accumulated image (image)
+ * (Binned natively, see node_addons/include/accumulatedimage.h)
+ * @param {Uint32Array} image accumulated image - bin_size x bin_size, row by row
+ * @param {Float32Array} centroids packed centroids of a frame (centroid_results.centroids)
  * @param {number} bin_size size of image to bin centroids into
- * @param {number} difference_increment amount to increment difference image pixel value (+1 for IR On, -1 for IR Off)
+ * @returns {number} number of centroids that landed in the image
  */
-function Image_update_image(image, centers, difference_image, bin_size, difference_increment = 1) {
-	let X, Y;
+function Image_update_image(image, centroids, bin_size) {
 	let initial_width = settings?.camera?.AoI_width || 1;
 	let initial_height = settings?.camera?.AoI_height || 1;
-	//let final_width = settings?.centroid?.bin_size || 1;
-	//let final_height = settings?.centroid?.bin_size || 1;
-	for (let i = 0; i < centers.length; i++) {
-		// Make sure centroid is not blank (i.e. [0, 0])
-		//if (centers[i][0] === 0 && centers[i][1] === 0) continue;
-		[X, Y] = centers[i];
-		// Need to account for accumulated image size and round to ints
-		X = Math.round((X * bin_size) / initial_width);
-		Y = Math.round((Y * bin_size) / initial_height);
-		if (image[Y] === undefined || image[Y][X] === undefined) {
-			continue; // X,Y point is outside of image
-		}
-		image[Y][X]++;
-		if (difference_image) difference_image[Y][X] += difference_increment;
-	}
+	if (!centroids || image.length < bin_size * bin_size) return 0; // (Image was deleted)
+	return camera.accumulateCentroids(image, centroids, bin_size, initial_width, initial_height);
 }
 
+// ImageData objects reused by Image_get_image_display, one per size
+// (Displays draw them with createImageBitmap, which copies the pixels right away)
+const image_display_data = new Map();
+
 /**
  * Convert image into ImageData object, scaling by contrast amount
- * @param {Array} image image to convert - 2D array
+ * @param {Uint32Array} image image to convert - bin_size x bin_size, row by row
+ * @param {number} bin_size width and height of image
  * @param {number} contrast amount to scale pixel values, ranges from 0 to 1
+ * @param {string} mapping how counts are mapped to gray levels ("linear", "sqrt" or "log")
  * @param {boolean} display_negative_values whether to display only negative (true) or only positive (false) pixel values
- * @returns {ImageData} selected image converted to ImageData object
+ * @param {Uint32Array} subtract_image image to subtract from image before displaying (for difference images)
+ * @returns {ImageData} selected image converted to ImageData object (reused by the next call with the same bin_size)
  */
-function Image_get_image_display(image, contrast, display_negative_values = false) {
-	let image_height = image.length;
-	let image_width = image[0].length;
-	let image_data = new ImageData(image_width, image_height);
-	let pixel;
-	for (let Y = 0; Y < image_height; Y++) {
-		for (let X = 0; X < image_width; X++) {
-			pixel = image[Y][X];
-			if (pixel === 0) continue; // Pixel is 0, can just skip
-			if (display_negative_values) pixel *= -1; // Invert pixel value to only show negative valued pixels
-			if (pixel < 0) pixel = 0; // Make sure only pixels >= 0 are displayed
-			// Adjust for contrast
-			pixel *= 255 * contrast;
-			if (pixel > 255) pixel = 255; // ImageData is 8bit, so max value is 255
-			// Want to make pixels white -> RGBA = [255, 255, 255, 255] (at full contrast)
-			for (let i = 0; i < 4; i++) {
-				image_data.data[4 * (image_width * Y + X) + i] = pixel;
-			}
+function Image_get_image_display(image, bin_size, contrast, mapping = "linear", display_negative_values = false, subtract_image) {
+	let image_data = image_display_data.get(bin_size);
+	if (!image_data) {
+		image_data = new ImageData(bin_size, bin_size);
+		image_display_data.set(bin_size, image_data);
+	}
+	if (!["linear", "sqrt", "log"].includes(mapping)) mapping = "linear";
+	// Pixels are rendered natively (see node_addons/include/imagedisplay.h)
+	let rendered = camera.renderAccumulatedImage(image_data.data, image, bin_size, contrast, mapping, display_negative_values, subtract_image);
+	if (!rendered) image_data.data.fill(0); // (Image was deleted)
+	return image_data;
+}
+
+/**
+ * Convert image into the text saved to file (one row per line, values separated by spaces)
+ * @param {Uint32Array} image image to convert - bin_size x bin_size, row by row
+ * @param {number} bin_size width and height of image
+ * @returns {string} image as text
+ */
+function Image_to_string(image, bin_size) {
+	let rows = [];
+	for (let Y = 0; Y < bin_size && (Y + 1) * bin_size <= image.length; Y++) {
+		rows.push(image.subarray(Y * bin_size, (Y + 1) * bin_size).join(" "));
+	}
+	return rows.join("\n");
+}
+
+/**
+ * Convert image read from file (array of rows) into an accumulated image
+ * @param {Array} rows image rows - 2D array
+ * @param {number} bin_size width and height of image
+ * @returns {Uint32Array} image - bin_size x bin_size, row by row
+ */
+function Image_from_rows(rows, bin_size) {
+	let image = new Uint32Array(bin_size * bin_size);
+	for (let Y = 0; Y < bin_size && Y < rows.length; Y++) {
+		for (let X = 0; X < bin_size && X < rows[Y].length; X++) {
+			image[bin_size * Y + X] = rows[Y][X] || 0;
 		}
 	}
-	return image_data;
+	return image;
 }
 
 /************************************************** 
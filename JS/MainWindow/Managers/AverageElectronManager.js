@@ -67,8 +67,8 @@ ipc.on(IPCMessages.UPDATE.NEWFRAME, (event, centroid_results) => {
 
 function rolling_20frames_update(centroid_results) {
 	const r2f = AverageElectronManager.rolling_20frames;
-	let com = centroid_results.com_centers.length;
-	let hgcm = centroid_results.hgcm_centers.length;
+	let com = centroid_results.com_count;
+	let hgcm = centroid_results.hgcm_count;
 	let total = com + hgcm;
 	if (centroid_results.is_led_on) {
 		r2f.on.com.push(com);
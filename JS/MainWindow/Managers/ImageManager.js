@@ -58,6 +58,7 @@ const ImageManager = {
 	params: {
 		image_contrast: 0.5,
 		decreased_image_contrast: false,
+		image_mapping: "linear", // How electron counts are shown on displays ("linear", "sqrt" or "log")
 		centroid: {
 			use_hybrid_method: true,
 			bin_size: 100,
@@ -133,8 +134,11 @@ const ImageManager = {
 	update_vmi: (vmi_info) => ImageManager_update_vmi(vmi_info),
 
 	single_shot: (ir_only) => {
+		// Frames only come with a full size image when one is asked for
+		ipc.send(IPCMessages.UPDATE.FULLIMAGE);
 		ipc.once(IPCMessages.UPDATE.NEWFRAME, (event, centroid_results) => {
 			if (ir_only && !centroid_results.is_led_on) ImageManager.single_shot(ir_only); // Try again until we get IR image
+			else if (!centroid_results.image_buffer || centroid_results.preview_scale !== 1) ImageManager.single_shot(ir_only); // Or one with a full size image
 			else ImageManager_single_shot(centroid_results);
 		});
 	},
@@ -423,7 +427,8 @@ function ImageManager_melexir_process_image(save_to_file) {
 
 	image_class.pe_spectrum.update_settings(ImageManager.melexir.params);
 
-	let melexir_arguments = {};
+	// (Accumulated images are sent as flat Uint32Arrays, the Melexir window splits them into rows)
+	let melexir_arguments = { bin_size: image_class.bin_size };
 	if (image_class.is_ir) {
 		melexir_arguments.is_ir = true;
 		melexir_arguments.images = {
@@ -602,7 +607,7 @@ function ImageManager_get_image_display(which_image) {
 	if (ImageManager.params.decreased_image_contrast) {
 		contrast /= 10;
 	}
-	return image_obj.get_image_display(which_image, contrast);
+	return image_obj.get_image_display(which_image, contrast, ImageManager.params.image_mapping);
 }
 
 function ImageManager_increase_id() {
@@ -717,10 +722,18 @@ async function ImageManager_single_shot(centroid_results) {
 	}
 	function convert_single_shot_centroids_to_string(centroid_results) {
 		let ssc_string = "";
-		ssc_string += `CoM Centroids \n${centroid_results.com_centers.map((row) => row.slice(0, 2).join(", ")).join("\n")} \n\n`;
-		ssc_string += `HGCM Centroids \n${centroid_results.hgcm_centers.map((row) => row.slice(0, 2).join(", ")).join("\n")}`;
+		ssc_string += `CoM Centroids \n${convert_centers_to_string(centroid_results.com_centers)} \n\n`;
+		ssc_string += `HGCM Centroids \n${convert_centers_to_string(centroid_results.hgcm_centers)}`;
 		return ssc_string;
 	}
+	function convert_centers_to_string(centers) {
+		// Centers are packed as X, Y, intensity of each centroid
+		let rows = [];
+		for (let i = 0; i < centers.length; i += 3) {
+			rows.push(`${centers[i]}, ${centers[i + 1]}`);
+		}
+		return rows.join("\n");
+	}
 }
 
 function ImageManager_save_scan_information() {
@@ -813,6 +826,7 @@ function ImageManager_process_settings(settings) {
 	if (settings?.centroid?.bin_size !== undefined) {
 		ImageManager.params.centroid.bin_size = settings.centroid.bin_size;
 	}
+	if (settings?.centroid?.image_mapping !== undefined) ImageManager.params.image_mapping = settings.centroid.image_mapping;
 
 	if (settings?.camera?.width !== undefined) ImageManager.params.camera.width = settings.camera.width;
 	if (settings?.camera?.height !== undefined) ImageManager.params.camera.height = settings.camera.height;
@@ -202,8 +202,10 @@ function create_live_view_window() {
 	Windows.live_view = win;
 
 	// Delete window reference when window is closed
+	// (and stop making live view images, since nobody can see them)
 	win.once("closed", (event) => {
 		Windows.live_view = undefined;
+		send_live_view_open();
 	});
 }
 
@@ -353,6 +355,16 @@ function send_settings(window) {
 	}
 }
 
+/**
+ * Tell the Invisible window whether the Live View window is open
+ * (Live view images are only made while it is)
+ */
+function send_live_view_open() {
+	if (Windows.invisible) {
+		Windows.invisible.webContents.send(IPCMessages.UPDATE.LIVEVIEWOPEN, Windows.live_view !== undefined);
+	}
+}
+
 /**
  * Send temporary settings to `window`
  * @param {BrowserWindow} window - Either Windows.main, Windows.live_view, or Windows.invisible
@@ -544,11 +556,13 @@ ipcMain.on(IPCMessages.READY.MAINWINDOW, (event, arg) => {
 // Live View window is ready, send the settings info
 ipcMain.on(IPCMessages.READY.LIVEVIEW, (event, arg) => {
 	send_settings(Windows.live_view);
+	send_live_view_open();
 });
 
 // Invisible window is ready, send the settings info
 ipcMain.on(IPCMessages.READY.INVISIBLE, (event, arg) => {
 	send_settings(Windows.invisible);
+	send_live_view_open();
 });
 
 // Main window has loaded and is ready to be displayed
@@ -569,6 +583,14 @@ ipcMain.on(IPCMessages.UPDATE.NEWFRAME, (event, info) => {
 	} catch {}
 });
 
+// Relay request for a full size image with the next frame (for a single shot) from Main window to Invisible window
+ipcMain.on(IPCMessages.UPDATE.FULLIMAGE, () => {
+	// Wrap in try/catch because it throws a bunch of errors if the window is closed
+	try {
+		Windows.invisible.webContents.send(IPCMessages.UPDATE.FULLIMAGE);
+	} catch {}
+});
+
 // Relay error message from Invisible window to Main window
 ipcMain.on(IPCMessages.UPDATE.CAMERAERROR, (event, error) => {
 	// Wrap in try/catch because it throws a bunch of errors if the window is closed
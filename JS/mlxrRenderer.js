@@ -2,6 +2,14 @@ const ipc = require("electron").ipcRenderer;
 const melexir = require("bindings")("melexir");
 
 ipc.on("run-mlxr", (event, data) => {
+	// Accumulated images come as flat Uint32Arrays (bin_size x bin_size, row by row), Melexir takes arrays of rows
+	if (data?.is_ir) {
+		data.images.ir_off = image_to_rows(data.images.ir_off, data.bin_size);
+		data.images.ir_on = image_to_rows(data.images.ir_on, data.bin_size);
+	} else if (data?.image) {
+		data.image = image_to_rows(data.image, data.bin_size);
+	}
+
 	if (process.platform === "darwin" && process.arch === "arm64") {
 		// Note from Marty: On my M1 mac, I can't run Melexir bc the library was compiled for x86 architecture
 		// If I want to actually use Melexir, I need to use Electron v13.1.6 (potentially other versions work too, newest version does not)
@@ -17,6 +25,14 @@ ipc.on("run-mlxr", (event, data) => {
 	ipc.send("mlxr-results", melexir_results);
 });
 
+function image_to_rows(image, bin_size) {
+	let rows = [];
+	for (let Y = 0; Y < bin_size; Y++) {
+		rows.push(Array.from(image.subarray(Y * bin_size, (Y + 1) * bin_size)));
+	}
+	return rows;
+}
+
 function process_image(data) {
 	if (!data) {
 		console.log("MLXR Worker: No image given!");
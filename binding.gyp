@@ -98,6 +98,70 @@
 				}]
 			]
 		},
+		{
+			"target_name": "centroid_benchmark",
+			"type": "executable",
+			"sources": ["node_addons/centroid_benchmark.cc"],
+			"include_dirs": [
+				"./node_addons/include"
+			],
+			"defines": ["cimg_display=0"],
+			"cflags": ["-std=c++11"],
+			'cflags!': [ '-fno-exceptions'],
+			'cflags_cc!': [ '-fno-exceptions' ],
+			'conditions': [
+				['OS=="win"', {
+                    "msvs_settings": {
+                        "VCCLCompilerTool": {
+                            "ExceptionHandling": 1
+                        }
+                    }
+				}],
+				['OS=="mac"', {
+					'xcode_settings': {
+						'GCC_ENABLE_CPP_EXCEPTIONS': 'YES'
+					},
+					"include_dirs": [
+						"/opt/X11/include"
+					]
+				}],
+				['OS=="linux"', {
+					"libraries": ["-lpthread"]
+				}]
+			]
+		},
+		{
+			"target_name": "recentroid",
+			"type": "executable",
+			"sources": ["node_addons/recentroid.cc"],
+			"include_dirs": [
+				"./node_addons/include"
+			],
+			"defines": ["cimg_display=0"],
+			"cflags": ["-std=c++11"],
+			'cflags!': [ '-fno-exceptions'],
+			'cflags_cc!': [ '-fno-exceptions' ],
+			'conditions': [
+				['OS=="win"', {
+                    "msvs_settings": {
+                        "VCCLCompilerTool": {
+                            "ExceptionHandling": 1
+                        }
+                    }
+				}],
+				['OS=="mac"', {
+					'xcode_settings': {
+						'GCC_ENABLE_CPP_EXCEPTIONS': 'YES'
+					},
+					"include_dirs": [
+						"/opt/X11/include"
+					]
+				}],
+				['OS=="linux"', {
+					"libraries": ["-lpthread"]
+				}]
+			]
+		},
 		{
 			"target_name": "melexir",
 			"sources": ["node_addons/melexir.cc"],
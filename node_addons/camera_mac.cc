@@ -1,32 +1,54 @@
 #include "camera.h"
 #include "centroid.h"
+#include "simulation.h"
+#include "fastsimulation.h"
+#include "triggerschedule.h"
+#include "recorder.h"
+#include "accumulatedimage.h"
+#include "imagedisplay.h"
+#include "recentroid.h"
+#include "previewstage.h"
+#include "resultqueue.h"
+#include "framering.h"
 #include <napi.h>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 
 
 // Global variables
 Camera camera; 							// Contains important info about the camera
 Centroid img; 							// Variables and functions for centroiding image
 Napi::FunctionReference eventEmitter; 	// Used to quickly send image and centroids to JS side
+FrameRecorder recorder;					// Saves raw frames to a file while recording
+ResultQueue results;					// Results waiting for JS (from the acquisition thread)
+FrameResult directResult;				// Results of a frame centroided by checkMessages()
+PreviewStage previewStage;				// Makes the live view's preview images (rate limited, separately from centroiding)
+ImageDisplay imageDisplay;				// Renders accumulated images for the Main window's displays
+std::thread acquisitionThread;			// Waits for frames and centroids them (after startAcquisition())
+std::atomic<bool> acquiring(false);		// Whether the acquisition thread should keep going
+std::atomic<bool> deliveryPending(false);	// Whether the JS thread has been asked to take the queued results
+std::atomic<unsigned long long> framesCentroided(0);	// Frames centroided by the acquisition thread
+std::mutex imageLock;					// Held while a frame is centroided, and by Napi functions that change img or camera memory
+Napi::ThreadSafeFunction resultDelivery;	// Calls deliverResults() on the JS thread
+FrameRing frameRing;					// Image memories the camera writes frames into in turn
+std::vector<Napi::Reference<Napi::Buffer<unsigned char> > > previewBuffers;	// Preview Buffers JS gave back with returnPreview(), to be filled again
+unsigned long long previewsReused = 0;	// Previews sent in a Buffer JS gave back, instead of a new one
 
 // Mac specific global variables
 int simImageWidth = 1024;				// Width of simulated image
 int simImageHeight = 768;				// Height of simulated image
-Timer triggerDelay; 					// Used for simulating 20Hz rep rate
-std::vector<char> simulatedImage; 		// Stand-in for image memory
-int repCount = 0; 						// Keep track of # of repetitions
-int simulationCount = 0;				// With above, used to check for skipped frames
-bool isIROn = false;					// Add in ability to make "IR On" images different
-bool useLED = true;						// Whether to add in intensity to simulate IR LED
-int baseNumberOfSpots = 55;				// Base number of electron spots to add to simulated image
-int numberOfSpotsVariation = 10;		// Variation of the number of electron spots
-std::vector<float> IROffRadii = {50, 90, 170, 300};
-std::vector<float> IROffWeights = {2, 4, 3, 1};
-std::vector<float> IROnRadii = {50, 90, 120, 170, 300};
-std::vector<float> IROnWeights = {2, 3, 2, 2, 1};
-
-
-// Constants
-float const pi = 3.14159265358979;
+TriggerSchedule triggerSchedule;		// Times of the simulated triggers (20Hz unless changed)
+std::condition_variable triggerChanged;	// Wakes the simulated camera when the trigger settings change (or to stop)
+std::vector<char> simulatedImage; 		// Simulated image (8 bits, before it is put in image memory)
+std::vector<std::vector<char> > simulatedMemory;	// Stand-in for the camera's image memories
+std::thread cameraThread;				// Simulates the camera writing a frame every 50ms (after startAcquisition())
+std::mutex simulatorLock;				// Held while a frame is simulated, and by Napi functions that change the simulator
+unsigned long long simulationCount = 0;	// Number of the next simulated trigger (and frame)
+unsigned long long framesSimulated = 0;	// Frames the simulated camera wrote into the ring
+FastImageSimulator simulator;			// Makes the simulated images (spot counts, radii, LED)
+PregeneratedFrames pregenerated;		// Simulated frames made ahead on a background thread
+int pregeneratedCount = 0;				// Frames made ahead (0 simulates each frame when the camera needs it)
 // End of global variables
 
 
@@ -36,110 +58,18 @@ float const pi = 3.14159265358979;
 	camelCase functions are C++ functions that can only be called from C++
 */ 
 
-// 
-// C++ functions
+//
+// C++ functions for just Mac
 //
 
-float gauss(int i, float center, float width)
-{
-	return sqrt(255) * exp(-pow(i - center, 2) / width);
-}
-
-void simulateImage(std::vector<char> &simImage, unsigned int randSeed) {
-	srand(randSeed); // Setting up random number generator
-
-	// Simulated values
-	int numberOfSpots = (rand() % numberOfSpotsVariation) + baseNumberOfSpots;
-	//std::vector<float> Radii = {30, 50, 90, 120, 170};
-	std::vector<float> Radii = IROffRadii;
-	std::vector<float> PeakWeights = IROffWeights;
-
-	// First clear the image (i.e. fill with 0's)
-	// 		(Unnecessary if adding noise)
-	//std::fill(std::begin(simImage), std::end(simImage), 0);
-
-	// Get center of image
-	//int imageCenterX = camera.width / 2;
-	//int imageCenterY = camera.height / 2;
-	int imageCenterX = img.xLowerBound + (img.xUpperBound - img.xLowerBound) / 2;
-	int imageCenterY = img.yLowerBound + (img.yUpperBound - img.yLowerBound) / 2;
-
-
-	// Add noise to the image
-	for (int i = 0; i < camera.imageLength;  i++) {
-		int noise = rand() % 5;
-		simImage[i] = (char)noise;
-	}
-
-	// Add in intensity to simulate IR LED
-	if (isIROn && useLED) {
-		for (int Y = img.LEDyLowerBound; Y < img.LEDyUpperBound; Y++) {
-			for (int X = img.LEDxLowerBound; X < img.LEDxUpperBound; X++) {
-				int intensity = rand() % 40 + 80;
-				simImage[camera.width * Y + X] = intensity;
-			}
-		}
-	}
-
-	if (isIROn) {
-		isIROn = false;
-		Radii = IROnRadii; 
-		PeakWeights = IROnWeights;
-		//return;
+// Start making simulated frames ahead again with the current settings (or stop, if pregeneratedCount is 0)
+// (simulatorLock must be held)
+void restartPregeneration() {
+	if (pregeneratedCount > 0 && !simulatedImage.empty()) {
+		simulator.area.copy(img);
+		pregenerated.start(simulator, pregeneratedCount, camera.width, camera.height, simulationCount);
 	} else {
-		isIROn = true;
-	}
-
-	int PeakWeightSum = 0;
-	for (int i = 0; i < PeakWeights.size(); i++) {
-		PeakWeightSum += PeakWeights[i];
-	}
-
-	// Add spots
-	int spotNumber = 0;
-	while (spotNumber < numberOfSpots)
-	{
-		// If sum of peak weights is <= 0, don't add any spots to image
-		if (PeakWeightSum <= 0) {
-			break;
-		}
-		int radiusProbability = (rand() % (1000*PeakWeightSum-1)) / 1000;
-		int radiusIndex = -1;
-		int weightSum = 0;
-		while (radiusProbability >= weightSum) {
-			radiusIndex++;
-			weightSum += PeakWeights[radiusIndex];
-		}
-		float radius = Radii[radiusIndex];
-		
-		// Using the physics def. of spherical coords
-		float phi = 2 * pi * ((rand() % RAND_MAX) / (1.0 * RAND_MAX)); 			// (0, 2pi)
-		float costheta = 2.0 * ((rand() % RAND_MAX) / (1.0 * RAND_MAX)) - 1.0; 	// (-1, 1)
-		float theta = acos(costheta);
-		float centerX = imageCenterX + radius * sin(theta) * cos(phi); // Converting to Cartesian coords
-		float centerY = imageCenterY + radius * cos(theta);
-		float widthX = (rand() % 50 + 100) / 10.0; // Randomly chooses widths btw 10.0 and 15.0 pixels (closer to real spot sizes)
-		float widthY = (rand() % 50 + 100) / 10.0;
-		float percentIntensity = (rand() % 60 + 50) / 100.0; // Choosing intensity btw 50% and 110%
-
-		// Add the spot to the image
-		for (int Y = centerY - 8; Y < centerY + 9; Y++)
-		{
-			for (int X = centerX - 8; X < centerX + 9; X++)
-			{
-				int intensity = round(gauss(Y, centerY, widthY) * gauss(X, centerX, widthX) * percentIntensity);
-				int currentIntensity = (unsigned char)simImage[camera.width * Y + X];
-				currentIntensity += intensity;
-				if (currentIntensity > 255)
-				{
-					currentIntensity = 255; // Cuts off intensity at 255
-				}
-				simImage[camera.width * Y + X] = currentIntensity;
-			}
-		}
-
-		spotNumber++;
-		
+		pregenerated.stop();
 	}
 }
 
@@ -149,26 +79,31 @@ void simulateImage(std::vector<char> &simImage, unsigned int randSeed) {
 
 Napi::Number SetBaseNumberOfSpots(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
 
 	if (info[0].IsNumber()) {
-		baseNumberOfSpots = reinterpret_cast<int>(info[0].ToNumber().Int32Value());
+		simulator.baseNumberOfSpots = reinterpret_cast<int>(info[0].ToNumber().Int32Value());
 	}
 
-	return Napi::Number::New(env, baseNumberOfSpots);
+	restartPregeneration();
+	return Napi::Number::New(env, simulator.baseNumberOfSpots);
 }
 
 Napi::Number SetNumberOfSpotsVariation(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
 
 	if (info[0].IsNumber()) {
-		numberOfSpotsVariation = reinterpret_cast<int>(info[0].ToNumber().Int32Value());
+		simulator.numberOfSpotsVariation = reinterpret_cast<int>(info[0].ToNumber().Int32Value());
 	}
 	
-	return Napi::Number::New(env, numberOfSpotsVariation);
+	restartPregeneration();
+	return Napi::Number::New(env, simulator.numberOfSpotsVariation);
 }
 
 Napi::Boolean SetIROffRadii(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
 
 	if (info[0].IsArray() && info[1].IsArray()) {
 		Napi::Array napiRadii = info[0].As<Napi::Array>();
@@ -184,8 +119,9 @@ Napi::Boolean SetIROffRadii(const Napi::CallbackInfo& info) {
 				radii.push_back(radius);
 				weights.push_back(weight);
 			}
-			IROffRadii = radii;
-			IROffWeights = weights;
+			simulator.IROffRadii = radii;
+			simulator.IROffWeights = weights;
+			restartPregeneration();
 			return Napi::Boolean::New(env, true);
 		}
 	}
@@ -195,6 +131,7 @@ Napi::Boolean SetIROffRadii(const Napi::CallbackInfo& info) {
 
 Napi::Boolean SetIROnRadii(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
 
 	if (info[0].IsArray() && info[1].IsArray()) {
 		Napi::Array napiRadii = info[0].As<Napi::Array>();
@@ -210,8 +147,9 @@ Napi::Boolean SetIROnRadii(const Napi::CallbackInfo& info) {
 				radii.push_back(radius);
 				weights.push_back(weight);
 			}
-			IROnRadii = radii;
-			IROnWeights = weights;
+			simulator.IROnRadii = radii;
+			simulator.IROnWeights = weights;
+			restartPregeneration();
 			return Napi::Boolean::New(env, true);
 		}
 	}
@@ -219,6 +157,98 @@ Napi::Boolean SetIROnRadii(const Napi::CallbackInfo& info) {
 	return Napi::Boolean::New(env, false);
 }
 
+// Set the number of simulated frames made ahead on a background thread
+// (Makes high simulated frame rates possible, 0 simulates each frame when the camera needs it)
+// @param {Number} - number of frames
+Napi::Number SetSimulatorPregeneration(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
+
+	if (info[0].IsNumber()) {
+		int count = (int)info[0].ToNumber().Int32Value();
+		pregeneratedCount = (count > 0) ? count : 0;
+		restartPregeneration();
+	}
+
+	return Napi::Number::New(env, pregeneratedCount);
+}
+
+// Set the rate of the simulated triggers
+// @param {Number} - triggers per second (Hz)
+Napi::Number SetRepetitionRate(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
+
+	if (info[0].IsNumber()) {
+		double rate = info[0].ToNumber().DoubleValue();
+		if (rate > 0) {
+			triggerSchedule.period = 1000 / rate;
+			triggerSchedule.start(simulationCount);
+			triggerChanged.notify_all();
+		}
+	}
+
+	return Napi::Number::New(env, 1000 / triggerSchedule.period);
+}
+
+// Set how far each simulated trigger can randomly be moved from its place
+// (Kept under half the trigger period, so triggers stay in order)
+// @param {Number} - most a trigger is moved (ms, 0 for none)
+Napi::Number SetTriggerJitter(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
+
+	if (info[0].IsNumber()) {
+		double jitter = info[0].ToNumber().DoubleValue();
+		triggerSchedule.jitter = (jitter > 0) ? jitter : 0;
+		triggerSchedule.start(simulationCount);
+		triggerChanged.notify_all();
+	}
+
+	return Napi::Number::New(env, triggerSchedule.jitter);
+}
+
+// Simulate triggers in bursts, with an extra pause after each burst
+// @param {Number} - triggers per burst (0 turns bursts off)
+// @param {Number} - extra pause after each burst (ms)
+Napi::Boolean SetBurstMode(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
+
+	if (!info[0].IsNumber() || !info[1].IsNumber()) {
+		return Napi::Boolean::New(env, false);
+	}
+	int burstLength = (int)info[0].ToNumber().Int32Value();
+	double burstPause = info[1].ToNumber().DoubleValue();
+	triggerSchedule.burstLength = (burstLength > 0) ? burstLength : 0;
+	triggerSchedule.burstPause = (burstPause > 0) ? burstPause : 0;
+	triggerSchedule.start(simulationCount);
+	triggerChanged.notify_all();
+
+	return Napi::Boolean::New(env, true);
+}
+
+// Get counts of simulated triggers and frames, to find the rate at which frames start being skipped
+// Returns object with
+//		triggers			-	Number	-	Simulated triggers so far
+//		frames_simulated	-	Number	-	Frames the simulated camera wrote into the ring
+//		frames_processed	-	Number	-	Frames centroided from the ring (since applyDefaultSettings())
+//		frames_skipped		-	Number	-	Frame numbers that were never centroided (since the image memories were allocated)
+//		repetition_rate		-	Number	-	Simulated trigger rate (Hz)
+Napi::Object GetSimulationStats(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(simulatorLock);
+
+	Napi::Object stats = Napi::Object::New(env);
+	stats["triggers"] = Napi::Number::New(env, simulationCount);
+	stats["frames_simulated"] = Napi::Number::New(env, framesSimulated);
+	stats["frames_processed"] = Napi::Number::New(env, frameRing.processedCount());
+	stats["frames_skipped"] = Napi::Number::New(env, frameRing.skippedCount());
+	stats["repetition_rate"] = Napi::Number::New(env, 1000 / triggerSchedule.period);
+
+	return stats;
+}
+
 
 //
 // Napi functions
@@ -228,14 +258,337 @@ Napi::Boolean SetIROnRadii(const Napi::CallbackInfo& info) {
 // @param {Boolean}
 Napi::Boolean UseHybridMethod(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	if (info[0].IsBoolean()) {
-		img.UseHybridMethod = info[0].ToBoolean();
+		img.setHybridMethod(info[0].ToBoolean());
 	}
 
 	return Napi::Boolean::New(env, img.UseHybridMethod);
 }
 
+// Whether to label regions from runs of lit pixels instead of pixel by pixel
+// @param {Boolean}
+Napi::Boolean UseRunLengthLabeling(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsBoolean()) {
+		img.UseRunLengthLabeling = info[0].ToBoolean();
+	}
+
+	return Napi::Boolean::New(env, img.UseRunLengthLabeling);
+}
+
+// Set the bit depth of camera images (8 for Mono8, 10/12/16 for Mono10/12/16)
+// Only works before applyDefaultSettings(), which sets the color mode and allocates the image memories
+// (Memories of the old depth would be too small for wider pixels, so later changes are ignored)
+// @param {Number} - bits per pixel
+// Returns the bit depth in use
+Napi::Number SetBitDepth(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::lock_guard<std::mutex> guard(imageLock);
+	std::lock_guard<std::mutex> simulatorGuard(simulatorLock); // (The simulator writes frames at the bit depth)
+
+	if (info[0].IsNumber()) {
+		int bits = (int)info[0].ToNumber().Int32Value();
+		if (bits == 8 || bits == 10 || bits == 12 || bits == 16) {
+			if (frameRing.size() == 0) {
+				camera.bitDepth = bits;
+				img.setBitDepth(bits);
+			} else if (bits != camera.bitDepth) {
+				std::cout << "Bit depth can't change once image memory is allocated, restart the camera to use " << bits << " bits" << std::endl;
+			}
+		}
+	}
+
+	return Napi::Number::New(env, camera.bitDepth);
+}
+
+// Set the number of image memories the camera writes frames into in turn
+// (More memories let centroiding fall further behind the camera for a while without skipping frames)
+// Must be called before applyDefaultSettings(), which allocates the memories
+// @param {Number} - number of memories (at least 2)
+Napi::Number SetFrameBufferCount(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info[0].IsNumber()) {
+		int count = (int)info[0].ToNumber().Int32Value();
+		if (count >= 2) {
+			camera.frameBufferCount = count;
+		}
+	}
+
+	return Napi::Number::New(env, camera.frameBufferCount);
+}
+
+
+// Set the number of threads used to centroid each image
+// @param {Number} - number of threads (1 centroids on the calling thread only)
+Napi::Number SetCentroidThreads(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		img.setThreadCount((int)info[0].ToNumber().Int32Value());
+	}
+
+	return Napi::Number::New(env, img.Workers.threadCount());
+}
+
+// Start saving each raw frame (AoI only) to a ring file
+// Arguments are (file path, number of frames the file holds)
+// Once the file is full, the oldest frames are overwritten
+// Must be called after applyDefaultSettings()
+// Returns true if the file was made
+Napi::Boolean StartRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber()) {
+		Napi::Error::New(env, "startRecording requires a file path and a number of frames").
+			ThrowAsJavaScriptException();
+		return Napi::Boolean::New(env, false);
+	}
+	std::string path = info[0].ToString().Utf8Value();
+	int frameCount = (int)info[1].ToNumber().Int32Value();
+
+	bool started = recorder.start(path, frameCount, camera.width, camera.height, camera.bitDepth);
+	if (!started) {
+		std::cout << "Could not start recording to " << path << std::endl;
+	}
+
+	return Napi::Boolean::New(env, started);
+}
+
+// Stop saving raw frames and close the file
+// Returns object with number of frames recorded and dropped (because the disk fell behind)
+Napi::Object StopRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	Napi::Object results = Napi::Object::New(env);
+	results["frames_recorded"] = Napi::Number::New(env, recorder.framesRecorded());
+	results["frames_dropped"] = Napi::Number::New(env, recorder.framesDropped());
+	recorder.stop();
+
+	return results;
+}
+
+// Centroids a recording again on a background thread (so JavaScript isn't blocked)
+class RecentroidWorker : public Napi::AsyncWorker
+{
+public:
+	RecentroidWorker(Napi::Env env, std::string recordingPath)
+		: Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)), path(recordingPath)
+	{
+	}
+
+	Napi::Promise::Deferred deferred;
+	std::string path;
+	Recentroider recentroider;
+	int frameCount = 0;
+
+	void Execute()
+	{
+		RecordingReader recording;
+		if (!recording.open(path)) {
+			SetError("Could not read recording " + path);
+			return;
+		}
+		frameCount = recording.frameCount();
+		recentroider.run(recording);
+	}
+
+	void OnOK()
+	{
+		Napi::Env env = Env();
+		int binSize = recentroider.settings.binSize;
+
+		Napi::Object output = Napi::Object::New(env);
+		output["frame_count"] = Napi::Number::New(env, frameCount);
+		output["computation_time"] = Napi::Number::New(env, recentroider.computationTime);
+		Napi::Uint8Array frameLEDOn = Napi::Uint8Array::New(env, frameCount);
+		memcpy(frameLEDOn.Data(), recentroider.frameLEDOn.data(), frameCount);
+		output["frame_led_on"] = frameLEDOn;
+
+		Napi::Array resultList = Napi::Array::New(env);
+		for (int t = 0; t < recentroider.results.size(); t++) {
+			RecentroidResult& result = recentroider.results[t];
+			Napi::Object resultObject = Napi::Object::New(env);
+			resultObject["threshold"] = Napi::Number::New(env, result.threshold);
+			resultObject["ir_off_electrons"] = Napi::Number::New(env, result.IROffCount);
+			resultObject["ir_on_electrons"] = Napi::Number::New(env, result.IROnCount);
+
+			// Centroids packed as [X, Y, intensity, method] (method is 0 for CoM, 1 for HGCM)
+			Napi::Float32Array centroids = Napi::Float32Array::New(env, 4 * result.centroids.size());
+			for (int i = 0; i < result.centroids.size(); i++) {
+				centroids[4*i] = result.centroids[i].X;
+				centroids[4*i + 1] = result.centroids[i].Y;
+				centroids[4*i + 2] = result.centroids[i].intensity;
+				centroids[4*i + 3] = result.centroids[i].method;
+			}
+			resultObject["centroids"] = centroids;
+			Napi::Uint32Array frameStart = Napi::Uint32Array::New(env, result.frameStart.size());
+			memcpy(frameStart.Data(), result.frameStart.data(), result.frameStart.size() * sizeof(unsigned int));
+			resultObject["frame_start"] = frameStart;
+
+			Napi::Uint32Array IROffImage = Napi::Uint32Array::New(env, binSize * binSize);
+			memcpy(IROffImage.Data(), result.IROffImage.data(), result.IROffImage.size() * sizeof(unsigned int));
+			resultObject["ir_off_image"] = IROffImage;
+			Napi::Uint32Array IROnImage = Napi::Uint32Array::New(env, binSize * binSize);
+			memcpy(IROnImage.Data(), result.IROnImage.data(), result.IROnImage.size() * sizeof(unsigned int));
+			resultObject["ir_on_image"] = IROnImage;
+
+			resultList.Set(t, resultObject);
+		}
+		output["results"] = resultList;
+
+		deferred.Resolve(output);
+	}
+
+	void OnError(const Napi::Error& error)
+	{
+		deferred.Reject(error.Value());
+	}
+};
+
+// Centroid every frame of a recording (made with startRecording()) again with new settings
+// Arguments are (file path, options), options can have
+//		thresholds	-	Array	-	Thresholds to try (default [20]), all done in one pass over the file
+//		min_pix		-	Number	-	Smallest region to centroid (default 3)
+//		max_pix		-	Number	-	Regions with this many pixels use HGCM (default 120)
+//		use_hybrid	-	Boolean	-	Whether to use HGCM for large regions (default true)
+//		threads		-	Number	-	Number of threads (default every core)
+//		bin_size	-	Number	-	Size of the accumulated images (default 1024)
+// Returns a Promise of the results (see camera_readme.md)
+Napi::Value RecentroidRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::Error::New(env, "recentroidRecording requires a file path").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+
+	RecentroidWorker* worker = new RecentroidWorker(env, info[0].ToString().Utf8Value());
+	RecentroidSettings& settings = worker->recentroider.settings;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].ToObject();
+		if (options.Has("thresholds") && options.Get("thresholds").IsArray()) {
+			Napi::Array thresholds = options.Get("thresholds").As<Napi::Array>();
+			settings.thresholds.clear();
+			for (int i = 0; i < thresholds.Length(); i++) {
+				settings.thresholds.push_back(thresholds.Get(i).ToNumber().Uint32Value());
+			}
+		}
+		if (options.Get("min_pix").IsNumber()) settings.minPix = options.Get("min_pix").ToNumber().Int32Value();
+		if (options.Get("max_pix").IsNumber()) settings.maxPix = options.Get("max_pix").ToNumber().Int32Value();
+		if (options.Get("use_hybrid").IsBoolean()) settings.useHybrid = options.Get("use_hybrid").ToBoolean();
+		if (options.Get("threads").IsNumber()) settings.threads = options.Get("threads").ToNumber().Int32Value();
+		if (options.Get("bin_size").IsNumber()) settings.binSize = options.Get("bin_size").ToNumber().Int32Value();
+	}
+
+	Napi::Promise promise = worker->deferred.Promise();
+	worker->Queue(); // (Deletes itself when done)
+	return promise;
+}
+
+// Add a frame's centroids to an accumulated image (in place, see accumulatedimage.h)
+// Arguments are (image, centroids, bin size, AoI width, AoI height)
+//		image		-	Uint32Array		-	Accumulated image (bin size x bin size, row by row)
+//		centroids	-	Float32Array	-	Packed centroids of the frame (centroid_results.centroids)
+// (Doesn't use the camera, so it can be called from any window)
+// Returns the number of centroids that landed in the image
+Napi::Value AccumulateCentroids(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 5 || !info[0].IsTypedArray() || !info[1].IsTypedArray()
+		|| info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array
+		|| info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+		Napi::TypeError::New(env, "accumulateCentroids requires (Uint32Array, Float32Array, binSize, AoIWidth, AoIHeight)").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	Napi::Uint32Array image = info[0].As<Napi::Uint32Array>();
+	Napi::Float32Array centroids = info[1].As<Napi::Float32Array>();
+	int binSize = info[2].ToNumber().Int32Value();
+	double AoIWidth = info[3].ToNumber().DoubleValue();
+	double AoIHeight = info[4].ToNumber().DoubleValue();
+	if (AoIWidth <= 0) AoIWidth = 1;
+	if (AoIHeight <= 0) AoIHeight = 1;
+
+	// Header is values per centroid, CoM count, HGCM count (see resultqueue.h)
+	const float* packed = centroids.Data();
+	if (binSize <= 0 || image.ElementLength() < (size_t)binSize * binSize || centroids.ElementLength() < CentroidHeaderSize) {
+		return Napi::Number::New(env, 0);
+	}
+	int floatsPerCentroid = (int)packed[0];
+	int count = (int)packed[1] + (int)packed[2];
+	if (floatsPerCentroid < 2 || centroids.ElementLength() < CentroidHeaderSize + (size_t)count * floatsPerCentroid) {
+		return Napi::Number::New(env, 0);
+	}
+	unsigned int binned = accumulateCentroids(image.Data(), binSize, packed + CentroidHeaderSize, count, floatsPerCentroid, AoIWidth, AoIHeight);
+
+	return Napi::Number::New(env, binned);
+}
+
+// Render an accumulated image into the pixels of an ImageData (see imagedisplay.h)
+// Arguments are (output, image, bin size, contrast, mapping, negative[, subtract])
+//		output		-	Uint8ClampedArray	-	ImageData.data of a bin size x bin size ImageData (overwritten)
+//		image		-	Uint32Array			-	Accumulated image (bin size x bin size, row by row)
+//		mapping		-	String				-	"linear", "sqrt" or "log"
+//		negative	-	Boolean				-	Whether to show only negative differences (difference images)
+//		subtract	-	Uint32Array			-	Image to take away from image first (difference images)
+// (Doesn't use the camera, so it can be called from any window)
+// Returns true if the image was rendered
+Napi::Value RenderAccumulatedImage(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 6 || !info[0].IsTypedArray() || !info[1].IsTypedArray() || !info[4].IsString()
+		|| info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_clamped_array
+		|| info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array) {
+		Napi::TypeError::New(env, "renderAccumulatedImage requires (Uint8ClampedArray, Uint32Array, binSize, contrast, mapping, negative[, Uint32Array])").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	std::string mappingName = info[4].As<Napi::String>().Utf8Value();
+	DisplayMapping mapping;
+	if (mappingName == "linear") {
+		mapping = DisplayMapping::Linear;
+	} else if (mappingName == "sqrt") {
+		mapping = DisplayMapping::Sqrt;
+	} else if (mappingName == "log") {
+		mapping = DisplayMapping::Log;
+	} else {
+		Napi::TypeError::New(env, "renderAccumulatedImage mapping has to be \"linear\", \"sqrt\" or \"log\"").ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	Napi::Uint8Array output = info[0].As<Napi::Uint8Array>();
+	Napi::Uint32Array image = info[1].As<Napi::Uint32Array>();
+	int binSize = info[2].ToNumber().Int32Value();
+	double contrast = info[3].ToNumber().DoubleValue();
+	bool negative = info[5].ToBoolean().Value();
+	const unsigned int* subtract = nullptr;
+	size_t count = (binSize > 0) ? (size_t)binSize * binSize : 0;
+	if (info.Length() > 6 && info[6].IsTypedArray()) {
+		if (info[6].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array) {
+			Napi::TypeError::New(env, "renderAccumulatedImage subtract image has to be a Uint32Array").ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+		Napi::Uint32Array subtractImage = info[6].As<Napi::Uint32Array>();
+		if (subtractImage.ElementLength() < count) return Napi::Boolean::New(env, false);
+		subtract = subtractImage.Data();
+	}
+	if (count == 0 || image.ElementLength() < count || output.ElementLength() < 4 * count) {
+		return Napi::Boolean::New(env, false);
+	}
+	imageDisplay.setMapping(mapping, contrast);
+	imageDisplay.render(output.Data(), image.Data(), subtract, (int)count, negative);
+
+	return Napi::Boolean::New(env, true);
+}
+
 // Pretend to create a WinAPI window to receive windows messages 
 // Returns true
 Napi::Boolean CreateWinAPIWindow(const Napi::CallbackInfo& info) {
@@ -292,12 +645,11 @@ Napi::Object GetInfo(const Napi::CallbackInfo& info) {
 // Returns true unless camera was not "initialized"
 Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	// Initialize image array for centroiding
-	img.Image.assign(camera.width, camera.height);
-	img.RegionImage.assign(camera.width, camera.height);
-	img.RegionVector.assign(1500, 3);
-	img.COMs.assign(1500, 4);
+	img.Image.assign(camera.width, camera.height); // (Image itself is read straight from camera memory)
+	img.RegionData.assign(1500); // (Grows if an image has more regions than this)
 
 	// Check to make sure camera was initialized first
 	if (!camera.connected) {
@@ -305,11 +657,29 @@ Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 		return Napi::Boolean::New(env, false);
 	}
 
-	// Create and fill array for simulated image
+	// Create and fill arrays for simulated image and the ring of image memories
+	// (Images are simulated in 8 bits, then scaled up into 2 bytes per pixel for Mono10/12/16)
+	std::lock_guard<std::mutex> simulatorGuard(simulatorLock);
+	int bytesPerPixel = (camera.bitDepth > 8) ? 2 : 1;
+	int memoryBytes = bytesPerPixel * camera.imageLength;
+	// (Settings are applied again on every settings update, often while acquiring, so the memories are kept if they still fit)
+	if (frameRing.size() == camera.frameBufferCount && frameRing.memoryBytes == memoryBytes) {
+		return Napi::Boolean::New(env, true);
+	}
+	// (The acquisition thread holds imageLock from taking a frame to releasing it, so no frame is taken while the ring is cleared)
 	simulatedImage.assign(camera.imageLength, 0);
+	simulatedMemory.assign(camera.frameBufferCount, std::vector<char>(memoryBytes, 0));
+	frameRing.clear();
+	for (int i = 0; i < camera.frameBufferCount; i++) {
+		frameRing.add(&simulatedMemory[i][0], i);
+	}
+	frameRing.memoryBytes = memoryBytes;
 
 	// Get image memory address
-	camera.pMem = &simulatedImage[0];
+	camera.pMem = frameRing.frames[0].pMem;
+
+	// (Frames made ahead were the old size)
+	restartPregeneration();
 
 	return Napi::Boolean::New(env, true);
 }
@@ -319,6 +689,7 @@ Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 // If only two arguments passed, assumed to be (AoI-Width, AoI-Height)
 void SetAoI(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -378,6 +749,10 @@ void SetAoI(const Napi::CallbackInfo& info) {
 	img.yLowerBound = topOffset;
 	img.yUpperBound = topOffset + AoIHeight;
 
+	// Simulated spots are centered on the AoI, so frames made ahead are out of date
+	std::lock_guard<std::mutex> simulatorGuard(simulatorLock);
+	restartPregeneration();
+
 	return;
 }
 
@@ -385,6 +760,7 @@ void SetAoI(const Napi::CallbackInfo& info) {
 // Arguments are (x-start, x-end, y-start, y-end)
 void SetLEDArea(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -407,6 +783,10 @@ void SetLEDArea(const Napi::CallbackInfo& info) {
 	img.LEDyLowerBound = reinterpret_cast<int>(info[2].ToNumber().Int32Value());
 	img.LEDyUpperBound = reinterpret_cast<int>(info[3].ToNumber().Int32Value());
 
+	// Frames made ahead have the LED in the old place
+	std::lock_guard<std::mutex> simulatorGuard(simulatorLock);
+	restartPregeneration();
+
 	return;
 }
 
@@ -414,6 +794,7 @@ void SetLEDArea(const Napi::CallbackInfo& info) {
 // Arguments are (x-start, x-end, y-start, y-end)
 void SetNoiseArea(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -503,85 +884,84 @@ Napi::Boolean EnableMessages(const Napi::CallbackInfo& info) {
 		return Napi::Boolean::New(env, false);
 	}
 
-	// Start the 20Hz triggering system
-	triggerDelay.start();
+	// Start the simulated triggers
+	std::lock_guard<std::mutex> guard(simulatorLock);
+	triggerSchedule.start(simulationCount);
 
 	return Napi::Boolean::New(env, true);
 }
 
+// Buffer holding a copy of a preview image, made on the JS thread
+// A Buffer JS gave back with returnPreview() is filled if one is the right size, so previews
+// don't allocate a new Buffer each time (Buffers have to be made by V8 inside Electron's memory cage,
+// so native memory can't be lent out instead)
+Napi::Buffer<unsigned char> previewBuffer(Napi::Env env, const std::vector<unsigned char>& image) {
+	while (!previewBuffers.empty()) {
+		Napi::Buffer<unsigned char> buffer = previewBuffers.back().Value();
+		previewBuffers.pop_back();
+		// (Buffers from before the preview size changed are let go)
+		if (buffer.Length() == image.size()) {
+			memcpy(buffer.Data(), image.data(), image.size());
+			previewsReused++;
+			return buffer;
+		}
+	}
+	return Napi::Buffer<unsigned char>::Copy(env, image.data(), image.size());
+}
+
 // Send message to JavaScript with calculated centers and computation time
 // Sent using emitter so JS side doesn't have to wait for results
-void sendCentroids() {
+void sendCentroids(FrameResult& result) {
 	Napi::Env env = eventEmitter.Env(); // Napi local environment
 	
 	// Package centroid information into an object to send to JS
 	Napi::Object centroidResults = Napi::Object::New(env);
 	// Contains:
-	// 		com_centers				-	Array		- Center of mass centroids
-	//		hgcm_centers			-	Array		- HGCM method centroids
+	// 		centroids				-	Float32Array	- Header, then CoM centroids, then HGCM centroids (see resultqueue.h)
+	// 		com_centers				-	Float32Array	- Center of mass centroids (X, Y, intensity of each, part of centroids)
+	//		hgcm_centers			-	Float32Array	- HGCM method centroids (same)
+	//		com_count				-	Number		- Number of CoM centroids
+	//		hgcm_count				-	Number		- Number of HGCM centroids
 	//		computation_time		-	Float		- Time to calculate centroids (ms)
 	//		is_led_on				- 	Boolean		- Whether IR LED was on in image
 	//		avg_led_intensity		-	Float		- Average intensity of pixels in LED region
 	//		avg_noise_intensity		-	Float		- Average intensity of pixels in noise region
-	
-	// First add the center of mass (CoM) centroids
-	Napi::Array centroidList = Napi::Array::New(env);
-	int centroidCounter = 0; // To keep track of how many center were found
-	for (int center = 0; center < img.Centroids[0].width(); center++) {
-		// Make sure x value is not 0 (i.e. make sure it's a real centroid)
-		if (img.Centroids(0, center, 0) > 0) {
-			Napi::Array spot = Napi::Array::New(env, 2); // centroid's coordinates
-
-			float xCenter = img.Centroids(0, center, 0);
-			float yCenter = img.Centroids(0, center, 1);
-			float avgInt = img.Centroids(0, center, 2);
-			// Account for offsets
-			xCenter -= img.xLowerBound;
-			yCenter -= img.yLowerBound;
-			spot.Set(Napi::Number::New(env, 0), Napi::Number::New(env, xCenter));
-			spot.Set(Napi::Number::New(env, 1), Napi::Number::New(env, yCenter));
-			// Also include average pixel intensity
-			spot.Set(Napi::Number::New(env, 2), Napi::Number::New(env, avgInt));
-
-			// Add spot to centroidList
-			centroidList.Set(centroidCounter, spot);
-			centroidCounter++;
-		}
-	}
-	centroidResults["com_centers"] = centroidList;
-
-	// Next add the hybrid gradient CoM (HGCM) method centroids
-	centroidList = Napi::Array::New(env);
-	centroidCounter = 0; // To keep track of how many center were found
-	for (int center = 0; center < img.Centroids[1].width(); center++) {
-		// Make sure x value is not 0 (i.e. make sure it's a real centroid)
-		if (img.Centroids(1, center, 0) > 0) {
-			Napi::Array spot = Napi::Array::New(env, 2); // centroid's coordinates
-
-			float xCenter = img.Centroids(1, center, 0);
-			float yCenter = img.Centroids(1, center, 1);
-			float avgInt = img.Centroids(1, center, 2);
-			// Account for offsets
-			xCenter -= img.xLowerBound;
-			yCenter -= img.yLowerBound;
-			spot.Set(Napi::Number::New(env, 0), Napi::Number::New(env, xCenter));
-			spot.Set(Napi::Number::New(env, 1), Napi::Number::New(env, yCenter));
-			// Also include average pixel intensity
-			spot.Set(Napi::Number::New(env, 2), Napi::Number::New(env, avgInt));
-
-			// Add spot to centroidList
-			centroidList.Set(centroidCounter, spot);
-			centroidCounter++;
-		}
-	}
-	centroidResults["hgcm_centers"] = centroidList;
+	//		region_table_resizes	-	Number		- Times the region table had to grow since startup
+	//		results_dropped			-	Number		- Results the acquisition thread dropped because JS fell behind
+	//		frame_number			-	Number		- Camera's number for the frame (gaps are frames that were skipped)
+	//		image_buffer			-	Buffer		- Preview image (RGBA), only on frames a preview was made of
+	//		preview_width			-	Number		- Width of the preview image
+	//		preview_height			-	Number		- Height of the preview image
+	//		preview_scale			-	Number		- Image pixels per preview pixel, each way
+
+	// Copy every centroid into one Float32Array, and give each method a view of its part
+	// (Offsets already accounted for)
+	size_t centroidBytes = result.centroids.size() * sizeof(float);
+	Napi::ArrayBuffer centroidBuffer = Napi::ArrayBuffer::New(env, centroidBytes);
+	memcpy(centroidBuffer.Data(), result.centroids.data(), centroidBytes);
+	size_t CoMOffset = CentroidHeaderSize * sizeof(float);
+	size_t HGCMOffset = CoMOffset + FloatsPerCentroid * result.CoMCount * sizeof(float);
+	centroidResults["centroids"] = Napi::Float32Array::New(env, result.centroids.size(), centroidBuffer, 0);
+	centroidResults["com_centers"] = Napi::Float32Array::New(env, FloatsPerCentroid * result.CoMCount, centroidBuffer, CoMOffset);
+	centroidResults["hgcm_centers"] = Napi::Float32Array::New(env, FloatsPerCentroid * result.HGCMCount, centroidBuffer, HGCMOffset);
+	centroidResults["com_count"] = Napi::Number::New(env, result.CoMCount);
+	centroidResults["hgcm_count"] = Napi::Number::New(env, result.HGCMCount);
 
 	// Add the other important values
-	centroidResults["computation_time"] = Napi::Number::New(env, img.computationTime);
-	centroidResults["is_led_on"] = Napi::Boolean::New(env, img.isLEDon);
-	centroidResults["avg_led_intensity"] = Napi::Number::New(env, img.LEDIntensity / img.LEDCount);
-	centroidResults["avg_noise_intensity"] = Napi::Number::New(env, img.NoiseIntensity / img.NoiseCount);
-	centroidResults["image_buffer"] = Napi::Buffer<unsigned char>::Copy(env, camera.buffer.data(), camera.buffer.size());
+	centroidResults["computation_time"] = Napi::Number::New(env, result.computationTime);
+	centroidResults["is_led_on"] = Napi::Boolean::New(env, result.isLEDOn);
+	centroidResults["avg_led_intensity"] = Napi::Number::New(env, result.avgLEDIntensity);
+	centroidResults["avg_noise_intensity"] = Napi::Number::New(env, result.avgNoiseIntensity);
+	centroidResults["region_table_resizes"] = Napi::Number::New(env, result.regionTableResizes);
+	centroidResults["results_dropped"] = Napi::Number::New(env, results.droppedCount());
+	centroidResults["frame_number"] = Napi::Number::New(env, result.frameNumber);
+	// Preview image, only on frames PreviewStage made one of
+	if (result.hasPreview) {
+		centroidResults["image_buffer"] = previewBuffer(env, result.buffer);
+		centroidResults["preview_width"] = Napi::Number::New(env, result.previewWidth);
+		centroidResults["preview_height"] = Napi::Number::New(env, result.previewHeight);
+		centroidResults["preview_scale"] = Napi::Number::New(env, result.previewScale);
+	}
 
 	// Send message to JavaScript with packaged results
 	eventEmitter.Call(
@@ -592,32 +972,301 @@ void sendCentroids() {
 	);
 }
 
+// Simulate the camera writing frame number frameNumber into the next memory of the ring
+// (simulatorLock must be held)
+void simulateFrame(unsigned long long frameNumber) {
+	RingFrame* frame = frameRing.nextWriteFrame();
+	if (frame == nullptr) return; // (Every memory is being centroided, so the camera has nowhere to put the frame)
+	// Take a frame made ahead, or simulate one now
+	// (take() doesn't wait if frames aren't being made ahead)
+	const char* image = simulatedImage.data();
+	PregeneratedFrame* pregeneratedFrame = pregenerated.take(100);
+	if (pregeneratedFrame != nullptr) {
+		image = pregeneratedFrame->image.data();
+	} else {
+		simulator.simulateImage(simulatedImage, (unsigned int)frameNumber, camera.width, camera.height, img);
+	}
+	if (camera.bitDepth > 8) {
+		unsigned short* pixels = reinterpret_cast<unsigned short*>(frame->pMem);
+		for (int i = 0; i < camera.imageLength; i++) {
+			pixels[i] = (unsigned char)image[i] << (camera.bitDepth - 8);
+		}
+	} else {
+		memcpy(frame->pMem, image, camera.imageLength);
+	}
+	pregenerated.release();
+	frameRing.frameWritten(frame, frameNumber);
+	framesSimulated++;
+}
+
+// Simulate a frame for each trigger that has come since the last one simulated
+// (If more triggers came than there are image memories, the older frames would only be overwritten,
+// so they aren't made, and their numbers count as skipped)
+// (simulatorLock must be held)
+void simulateTriggers() {
+	unsigned long long nextTrigger = triggerSchedule.nextTrigger(triggerSchedule.now());
+	if (nextTrigger > simulationCount + frameRing.size()) {
+		simulationCount = nextTrigger - frameRing.size();
+	}
+	while (simulationCount < nextTrigger) {
+		simulateFrame(simulationCount);
+		simulationCount++;
+	}
+}
+
+// Centroid a frame of the ring
+// (imageLock must be held)
+void centroidFrame(RingFrame& frame) {
+	// Get image pitch
+	int pPitch = (camera.bitDepth > 8) ? 2 * camera.width : camera.width;
+	// Centroid
+	img.centroid(frame.pMem, pPitch);
+	// Make the live view's preview image, if one is due
+	previewStage.render(camera.buffer, frame.pMem, pPitch, camera.width, camera.height, camera.bitDepth);
+	// Save raw frame (if recording)
+	recorder.record(frame.pMem, pPitch, img.xLowerBound, img.yLowerBound,
+		img.xUpperBound - img.xLowerBound, img.yUpperBound - img.yLowerBound, img.isLEDon);
+}
+
 // Check for messages
 void CheckMessages(const Napi::CallbackInfo& info) {
-	// Check if it's been more than 50ms since the last trigger event
-	triggerDelay.end();
-	repCount = floor(triggerDelay.time / 50);
-	while (simulationCount < repCount) {
-		if (repCount - simulationCount >= 3) {
-			simulationCount = repCount;
-		}
-		// (Upper time limit to test if any frames are missed)
-		// Simulate image
-		unsigned int randint = ((unsigned long long)triggerDelay.time) % UINT_MAX; // RNG seed
-		simulateImage(simulatedImage, randint);
-		// Get image pitch
-		int pPitch = camera.width;
-		// Centroid
-		img.centroid(camera.buffer, camera.pMem, pPitch);
+	// Simulate the triggers since the last check
+	{
+		std::lock_guard<std::mutex> guard(simulatorLock);
+		simulateTriggers();
+	}
+
+	// Centroid every new frame, oldest first
+	std::lock_guard<std::mutex> guard(imageLock);
+	RingFrame* frame;
+	while ((frame = frameRing.takeFrame()) != nullptr) {
+		centroidFrame(*frame);
 		// Return calculated centers
-		sendCentroids();
-		simulationCount++;
+		directResult.copy(img, camera.buffer, previewStage);
+		directResult.frameNumber = frame->frameNumber;
+		sendCentroids(directResult);
+		frameRing.release(frame);
 	}
 }
 
+// Send every queued result to JavaScript
+// (Called on the JS thread through resultDelivery)
+void deliverResults(Napi::Env env, Napi::Function emit) {
+	deliveryPending = false; // (Results queued from here on need another call)
+	FrameResult* result;
+	while ((result = results.front()) != nullptr) {
+		sendCentroids(*result);
+		results.pop();
+	}
+}
+
+// Queue the results of the frame just centroided, and ask the JS thread to take them
+// Never waits for JS: if the queue is full the results are dropped (and counted)
+// (Called on the acquisition thread with imageLock held)
+void queueResults(unsigned long long frameNumber) {
+	framesCentroided++;
+	FrameResult* result = results.reserve();
+	if (result == nullptr) {
+		previewStage.take(); // (So the preview doesn't end up with a later frame)
+		return;
+	}
+	result->copy(img, camera.buffer, previewStage);
+	result->frameNumber = frameNumber;
+	results.publish();
+	// Only one delivery call needs to be waiting at a time
+	if (!deliveryPending.exchange(true)) {
+		if (resultDelivery.NonBlockingCall(deliverResults) != napi_ok) {
+			deliveryPending = false;
+		}
+	}
+}
+
+// Simulated camera loop, writes a frame into the ring at each trigger of triggerSchedule
+void simulateCamera() {
+	std::unique_lock<std::mutex> guard(simulatorLock);
+	while (acquiring) {
+		// Wait for the next trigger (or for the trigger settings to change)
+		double wait = triggerSchedule.time(simulationCount) - triggerSchedule.now();
+		if (wait > 0) {
+			triggerChanged.wait_for(guard, std::chrono::microseconds((long long)(1000 * wait)));
+			continue;
+		}
+		simulateTriggers();
+	}
+}
+
+// Acquisition thread loop, centroids each frame the (simulated) camera writes, oldest first
+void acquireFrames() {
+	while (acquiring) {
+		// (Times out now and then to check whether to stop)
+		if (!frameRing.waitForNewFrame(100)) continue;
+
+		// Centroid every new frame, oldest first
+		// (Frames are only taken with imageLock held, so applyDefaultSettings() can't clear the ring under one)
+		std::lock_guard<std::mutex> guard(imageLock);
+		RingFrame* frame;
+		while ((frame = frameRing.takeFrame()) != nullptr) {
+			centroidFrame(*frame);
+			queueResults(frame->frameNumber);
+			frameRing.release(frame);
+		}
+	}
+}
+
+// Stop the acquisition thread (if running) and wait for it to finish
+void stopAcquisition() {
+	if (!acquisitionThread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> guard(simulatorLock);
+		acquiring = false;
+	}
+	triggerChanged.notify_all();
+	cameraThread.join();
+	acquisitionThread.join();
+	resultDelivery.Release();
+}
+
+// Start centroiding frames on a separate thread
+// Results are sent with the emitter ("new-image") as they are ready, so checkMessages() is not needed
+// initEmitter() has to be called first
+// Returns true unless the emitter isn't set up or frames can't be waited for
+Napi::Boolean StartAcquisition(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (eventEmitter.IsEmpty() || !camera.connected) {
+		return Napi::Boolean::New(env, false);
+	}
+	stopAcquisition();
+
+	// Start the simulated triggers
+	{
+		std::lock_guard<std::mutex> guard(simulatorLock);
+		triggerSchedule.start(simulationCount);
+	}
+	resultDelivery = Napi::ThreadSafeFunction::New(env, eventEmitter.Value(), "camera-results", 0, 1);
+	acquiring = true;
+	acquisitionThread = std::thread(acquireFrames);
+	cameraThread = std::thread(simulateCamera);
+
+	return Napi::Boolean::New(env, true);
+}
+
+// Stop centroiding frames on a separate thread
+void StopAcquisition(const Napi::CallbackInfo& info) {
+	stopAcquisition();
+}
+
+// Get counts of frames centroided by the acquisition thread, and of frames that were skipped
+// Returns object with
+//		frames_centroided		-	Number	-	Frames centroided by the acquisition thread
+//		results_sent			-	Number	-	Results queued for JS
+//		results_dropped			-	Number	-	Results JS didn't take in time
+//		frames_skipped			-	Number	-	Frame numbers that were never centroided (since the image memories were allocated)
+//		skipped_frame_numbers	-	Array	-	The most recent skipped frame numbers
+//		previews_made			-	Number	-	Preview images made (they are rate limited)
+//		previews_reused			-	Number	-	Previews sent in a Buffer given back with returnPreview()
+Napi::Object GetAcquisitionStats(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	Napi::Object stats = Napi::Object::New(env);
+	stats["frames_centroided"] = Napi::Number::New(env, framesCentroided);
+	stats["results_sent"] = Napi::Number::New(env, results.resultCount());
+	stats["results_dropped"] = Napi::Number::New(env, results.droppedCount());
+	stats["frames_skipped"] = Napi::Number::New(env, frameRing.skippedCount());
+	std::vector<unsigned long long> skippedFrames = frameRing.recentSkippedFrames();
+	Napi::Array skippedList = Napi::Array::New(env, skippedFrames.size());
+	for (int i = 0; i < skippedFrames.size(); i++) {
+		skippedList.Set(i, Napi::Number::New(env, skippedFrames[i]));
+	}
+	stats["skipped_frame_numbers"] = skippedList;
+	stats["previews_made"] = Napi::Number::New(env, previewStage.renderedCount());
+	stats["previews_reused"] = Napi::Number::New(env, previewsReused);
+
+	return stats;
+}
+
+// Turn the live view's preview images on or off
+// (Off while nobody is looking, so frames only cost centroiding)
+// @param {Boolean}
+Napi::Boolean SetPreviewEnabled(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsBoolean()) {
+		previewStage.enabled = info[0].ToBoolean();
+	}
+
+	return Napi::Boolean::New(env, previewStage.enabled);
+}
+
+// Set the most preview images made per second (0 makes one of every frame)
+// @param {Number} - previews per second
+Napi::Number SetPreviewRate(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		double rate = info[0].ToNumber().DoubleValue();
+		if (rate >= 0) previewStage.maxRate = rate;
+	}
+
+	return Napi::Number::New(env, previewStage.maxRate);
+}
+
+// Set how much preview images are downscaled (1, 2 or 4 image pixels per preview pixel, each way)
+// @param {Number} - scale
+Napi::Number SetPreviewScale(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		previewStage.setScale(info[0].ToNumber().Int32Value());
+	}
+
+	return Napi::Number::New(env, previewStage.scale);
+}
+
+// Send a full size preview image with the next frame, even if previews are off
+// (For saving a single shot)
+void RequestFullImage(const Napi::CallbackInfo& info) {
+	std::lock_guard<std::mutex> guard(imageLock);
+	previewStage.requestFullImage();
+}
+
+// Give back the image_buffer of a result once JS is done with it, so a later preview can be sent in it
+// (JS must not use the Buffer after this. Buffers that aren't given back are just garbage collected)
+// @param {Buffer}
+void ReturnPreview(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() != 1 || !info[0].IsBuffer()) {
+		Napi::Error::New(env, "returnPreview requires a Buffer").
+			ThrowAsJavaScriptException();
+		return;
+	}
+	Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char> >();
+	if (previewBuffers.size() >= PreviewBuffersKept) return;
+	// (A Buffer given back twice would otherwise be sent with two results)
+	for (int i = 0; i < previewBuffers.size(); i++) {
+		if (previewBuffers[i].Value().StrictEquals(buffer)) return;
+	}
+	previewBuffers.push_back(Napi::Persistent(buffer));
+}
+
+
 // Pretend to close the camera
 void Close(const Napi::CallbackInfo& info) {
+	stopAcquisition();
+	recorder.stop();
+	pregenerated.stop();
+	// (The image memories are made again on the next applyDefaultSettings(), so the bit depth can be changed again)
+	{
+		std::lock_guard<std::mutex> guard(imageLock);
+		std::lock_guard<std::mutex> simulatorGuard(simulatorLock);
+		frameRing.clear();
+	}
 	camera.connected = false;
+	previewBuffers.clear();
 }
 
 // Set up emitter to communicate with JavaScript
@@ -631,6 +1280,7 @@ void InitEmitter(const Napi::CallbackInfo& info) {
 // returns buffer
 Napi::Value InitBuffer(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	// Initialize buffer in camera object
 	camera.buffer.assign(4 * camera.imageLength, 0);
@@ -647,6 +1297,15 @@ Napi::Value InitBuffer(const Napi::CallbackInfo& info) {
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	// Fill exports object with addon functions
 	exports["useHybridMethod"] = Napi::Function::New(env, UseHybridMethod);
+	exports["useRunLengthLabeling"] = Napi::Function::New(env, UseRunLengthLabeling);
+	exports["setCentroidThreads"] = Napi::Function::New(env, SetCentroidThreads);
+	exports["startRecording"] = Napi::Function::New(env, StartRecording);
+	exports["stopRecording"] = Napi::Function::New(env, StopRecording);
+	exports["recentroidRecording"] = Napi::Function::New(env, RecentroidRecording);
+	exports["accumulateCentroids"] = Napi::Function::New(env, AccumulateCentroids);
+	exports["renderAccumulatedImage"] = Napi::Function::New(env, RenderAccumulatedImage);
+	exports["setBitDepth"] = Napi::Function::New(env, SetBitDepth);
+	exports["setFrameBufferCount"] = Napi::Function::New(env, SetFrameBufferCount);
 	exports["createWinAPIWindow"] = Napi::Function::New(env, CreateWinAPIWindow);
 	exports["connect"] = Napi::Function::New(env, Connect);
 	exports["getInfo"] = Napi::Function::New(env, GetInfo);
@@ -662,6 +1321,14 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	exports["startCapture"] = Napi::Function::New(env, StartCapture);
 	exports["enableMessages"] = Napi::Function::New(env, EnableMessages);
 	exports["checkMessages"] = Napi::Function::New(env, CheckMessages);
+	exports["startAcquisition"] = Napi::Function::New(env, StartAcquisition);
+	exports["stopAcquisition"] = Napi::Function::New(env, StopAcquisition);
+	exports["getAcquisitionStats"] = Napi::Function::New(env, GetAcquisitionStats);
+	exports["setPreviewEnabled"] = Napi::Function::New(env, SetPreviewEnabled);
+	exports["setPreviewRate"] = Napi::Function::New(env, SetPreviewRate);
+	exports["setPreviewScale"] = Napi::Function::New(env, SetPreviewScale);
+	exports["requestFullImage"] = Napi::Function::New(env, RequestFullImage);
+	exports["returnPreview"] = Napi::Function::New(env, ReturnPreview);
 	exports["close"] = Napi::Function::New(env, Close);
 	exports["initEmitter"] = Napi::Function::New(env, InitEmitter);
 	exports["initBuffer"] = Napi::Function::New(env, InitBuffer);
@@ -671,6 +1338,11 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	exports["setNumberOfSpotsVariation"] = Napi::Function::New(env, SetNumberOfSpotsVariation);
 	exports["setIROffRadii"] = Napi::Function::New(env, SetIROffRadii);
 	exports["setIROnRadii"] = Napi::Function::New(env, SetIROnRadii);
+	exports["setSimulatorPregeneration"] = Napi::Function::New(env, SetSimulatorPregeneration);
+	exports["setRepetitionRate"] = Napi::Function::New(env, SetRepetitionRate);
+	exports["setTriggerJitter"] = Napi::Function::New(env, SetTriggerJitter);
+	exports["setBurstMode"] = Napi::Function::New(env, SetBurstMode);
+	exports["getSimulationStats"] = Napi::Function::New(env, GetSimulationStats);
 
 	return exports;
 }
@@ -6,18 +6,42 @@
 #include "centroid.h"
 #include <string>
 #include <napi.h>
+#include <atomic>
+#include <thread>
 #include <windows.h>
 #include <uEye.h>
 #include "uEyeErrors.h"
+#include "recorder.h"
+#include "accumulatedimage.h"
+#include "imagedisplay.h"
+#include "recentroid.h"
+#include "previewstage.h"
+#include "resultqueue.h"
+#include "framering.h"
 
 // Global variables
 Camera camera; // Contains important info about the camera
 Centroid img; // Variables and functions for centroiding image
 Napi::FunctionReference eventEmitter; // Used to quickly send image and centroids to JS side
+FrameRecorder recorder; // Saves raw frames to a file while recording
+ResultQueue results;					// Results waiting for JS (from the acquisition thread)
+FrameResult directResult;				// Results of a frame centroided by checkMessages()
+PreviewStage previewStage;				// Makes the live view's preview images (rate limited, separately from centroiding)
+ImageDisplay imageDisplay;				// Renders accumulated images for the Main window's displays
+std::thread acquisitionThread;			// Waits for frames and centroids them (after startAcquisition())
+std::atomic<bool> acquiring(false);		// Whether the acquisition thread should keep going
+std::atomic<bool> deliveryPending(false);	// Whether the JS thread has been asked to take the queued results
+std::atomic<unsigned long long> framesCentroided(0);	// Frames centroided by the acquisition thread
+std::mutex imageLock;					// Held while a frame is centroided, and by Napi functions that change img or camera memory
+Napi::ThreadSafeFunction resultDelivery;	// Calls deliverResults() on the JS thread
+FrameRing frameRing;					// Image memories the camera writes frames into in turn
+std::vector<Napi::Reference<Napi::Buffer<unsigned char> > > previewBuffers;	// Preview Buffers JS gave back with returnPreview(), to be filled again
+unsigned long long previewsReused = 0;	// Previews sent in a Buffer JS gave back, instead of a new one
 
 // Windows specific global variables
 HWND hWnd;
 HIDS hCam = 0;
+HANDLE frameEvent = NULL;	// Signaled by the camera for each frame (used by the acquisition thread)
 // End of global variables
 
 
@@ -32,15 +56,86 @@ HIDS hCam = 0;
 // @param {Boolean}
 Napi::Boolean UseHybridMethod(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	if (info[0].IsBoolean()) {
-		img.UseHybridMethod = info[0].ToBoolean();
+		img.setHybridMethod(info[0].ToBoolean());
 	}
 
 	return Napi::Boolean::New(env, img.UseHybridMethod);
 }
 
 
+// Whether to label regions from runs of lit pixels instead of pixel by pixel
+// @param {Boolean}
+Napi::Boolean UseRunLengthLabeling(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsBoolean()) {
+		img.UseRunLengthLabeling = info[0].ToBoolean();
+	}
+
+	return Napi::Boolean::New(env, img.UseRunLengthLabeling);
+}
+
+
+// Set the bit depth of camera images (8 for Mono8, 10/12/16 for Mono10/12/16)
+// Only works before applyDefaultSettings(), which sets the color mode and allocates the image memories
+// (Memories of the old depth would be too small for wider pixels, so later changes are ignored)
+// @param {Number} - bits per pixel
+// Returns the bit depth in use
+Napi::Number SetBitDepth(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		int bits = (int)info[0].ToNumber().Int32Value();
+		if (bits == 8 || bits == 10 || bits == 12 || bits == 16) {
+			if (frameRing.size() == 0) {
+				camera.bitDepth = bits;
+				img.setBitDepth(bits);
+			} else if (bits != camera.bitDepth) {
+				std::cout << "Bit depth can't change once image memory is allocated, restart the camera to use " << bits << " bits" << std::endl;
+			}
+		}
+	}
+
+	return Napi::Number::New(env, camera.bitDepth);
+}
+
+// Set the number of image memories the camera writes frames into in turn
+// (More memories let centroiding fall further behind the camera for a while without skipping frames)
+// Must be called before applyDefaultSettings(), which allocates the memories
+// @param {Number} - number of memories (at least 2)
+Napi::Number SetFrameBufferCount(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info[0].IsNumber()) {
+		int count = (int)info[0].ToNumber().Int32Value();
+		if (count >= 2) {
+			camera.frameBufferCount = count;
+		}
+	}
+
+	return Napi::Number::New(env, camera.frameBufferCount);
+}
+
+
+// Set the number of threads used to centroid each image
+// @param {Number} - number of threads (1 centroids on the calling thread only)
+Napi::Number SetCentroidThreads(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		img.setThreadCount((int)info[0].ToNumber().Int32Value());
+	}
+
+	return Napi::Number::New(env, img.Workers.threadCount());
+}
+
+
 // Create a WinAPI window to receive windows messages 
 // (e.g. frame event from camera)
 // Returns whether window was created
@@ -140,6 +235,7 @@ Napi::Object GetInfo(const Napi::CallbackInfo& info) {
 // If only two arguments passed, assumed to be (AoI-Width, AoI-Height)
 void SetAoI(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -206,6 +302,7 @@ void SetAoI(const Napi::CallbackInfo& info) {
 // Arguments are (x-start, x-end, y-start, y-end)
 void SetLEDArea(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -235,6 +332,7 @@ void SetLEDArea(const Napi::CallbackInfo& info) {
 // Arguments are (x-start, x-end, y-start, y-end)
 void SetNoiseArea(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	int argLength = info.Length(); // Number of arguments passed
 
@@ -264,12 +362,11 @@ void SetNoiseArea(const Napi::CallbackInfo& info) {
 // Returns false unless all were successful
 Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	// Initialize image array for centroiding
-	img.Image.assign(camera.width, camera.height);
-	img.RegionImage.assign(camera.width, camera.height);
-	img.RegionVector.assign(2500, 3);
-	img.COMs.assign(2500, 4);
+	img.Image.assign(camera.width, camera.height); // (Image itself is read straight from camera memory)
+	img.RegionData.assign(2500); // (Grows if an image has more regions than this)
 
 	// Check to make sure camera was initialized first
 	if (!camera.connected) {
@@ -279,8 +376,12 @@ Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 
 	int nRet; // Return values from uEye functions
 
-	// Set color mode
-	nRet = is_SetColorMode(hCam, IS_CM_MONO8);
+	// Set color mode (Mono10/12/16 are stored in 2 bytes per pixel)
+	int colorMode = IS_CM_MONO8;
+	if (camera.bitDepth == 10) colorMode = IS_CM_MONO10;
+	if (camera.bitDepth == 12) colorMode = IS_CM_MONO12;
+	if (camera.bitDepth == 16) colorMode = IS_CM_MONO16;
+	nRet = is_SetColorMode(hCam, colorMode);
 	if (nRet != IS_SUCCESS) {
 		std::cout << "Setting color mode failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
 		return Napi::Boolean::New(env, false);
@@ -293,20 +394,44 @@ Napi::Boolean ApplyDefaultSettings(const Napi::CallbackInfo& info) {
 		return Napi::Boolean::New(env, false);
 	}
 
-	// Allocate memory for images
-	// Fills pMem with image memory address
-	nRet = is_AllocImageMem(hCam, camera.width, camera.height, 8, &camera.pMem, &camera.memID);
-	if (nRet != IS_SUCCESS) {
-		std::cout << "Allocating memory failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
-		return Napi::Boolean::New(env, false);
+	// Keep the memories from an earlier call if they still fit
+	// (Settings are applied again on every settings update, often while acquiring)
+	int bitsPerPixel = (camera.bitDepth > 8) ? 16 : 8;
+	int memoryBytes = bitsPerPixel / 8 * camera.imageLength;
+	if (frameRing.size() == camera.frameBufferCount && frameRing.memoryBytes == memoryBytes) {
+		return Napi::Boolean::New(env, true);
 	}
 
-	// Tell camera where to put image data
-	nRet = is_SetImageMem(hCam, camera.pMem, camera.memID);
-	if (nRet != IS_SUCCESS) {
-		std::cout << "Setting active memory failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
-		return Napi::Boolean::New(env, false);
+	// Free memory from any earlier call
+	// (The acquisition thread holds imageLock from taking a frame to releasing it, so no frame is taken while the ring is cleared)
+	is_ClearSequence(hCam);
+	for (int i = 0; i < frameRing.size(); i++) {
+		is_FreeImageMem(hCam, frameRing.frames[i].pMem, frameRing.frames[i].memID);
+	}
+	frameRing.clear();
+
+	// Allocate a ring of image memories, which the camera fills in turn
+	// (so a frame that takes a while to centroid doesn't leave the camera nowhere to put the next one)
+	for (int i = 0; i < camera.frameBufferCount; i++) {
+		char* pMem;
+		int memID;
+		nRet = is_AllocImageMem(hCam, camera.width, camera.height, bitsPerPixel, &pMem, &memID);
+		if (nRet != IS_SUCCESS) {
+			std::cout << "Allocating memory failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
+			return Napi::Boolean::New(env, false);
+		}
+		// Tell camera it can put image data here
+		nRet = is_AddToSequence(hCam, pMem, memID);
+		if (nRet != IS_SUCCESS) {
+			std::cout << "Adding memory to sequence failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
+			is_FreeImageMem(hCam, pMem, memID);
+			return Napi::Boolean::New(env, false);
+		}
+		frameRing.add(pMem, memID);
 	}
+	frameRing.memoryBytes = memoryBytes;
+	camera.pMem = frameRing.frames[0].pMem;
+	camera.memID = frameRing.frames[0].memID;
 	
 	return Napi::Boolean::New(env, true);
 }
@@ -557,79 +682,77 @@ Napi::Boolean EnableMessages(const Napi::CallbackInfo& info) {
 	return Napi::Boolean::New(env, true);
 }
 
+// Buffer holding a copy of a preview image, made on the JS thread
+// A Buffer JS gave back with returnPreview() is filled if one is the right size, so previews
+// don't allocate a new Buffer each time (Buffers have to be made by V8 inside Electron's memory cage,
+// so native memory can't be lent out instead)
+Napi::Buffer<unsigned char> previewBuffer(Napi::Env env, const std::vector<unsigned char>& image) {
+	while (!previewBuffers.empty()) {
+		Napi::Buffer<unsigned char> buffer = previewBuffers.back().Value();
+		previewBuffers.pop_back();
+		// (Buffers from before the preview size changed are let go)
+		if (buffer.Length() == image.size()) {
+			memcpy(buffer.Data(), image.data(), image.size());
+			previewsReused++;
+			return buffer;
+		}
+	}
+	return Napi::Buffer<unsigned char>::Copy(env, image.data(), image.size());
+}
+
 // Send message to JavaScript with calculated centers and computation time
 // Sent using emitter so JS side doesn't have to wait for results
-void sendCentroids() {
+void sendCentroids(FrameResult& result) {
 	Napi::Env env = eventEmitter.Env(); // Napi local environment
 	
 	// Package centroid information into an object to send to JS
 	Napi::Object centroidResults = Napi::Object::New(env);
 	// Contains:
-	// 		com_centers				-	Array		- Center of mass centroids
-	//		hgcm_centers			-	Array		- HGCM method centroids
+	// 		centroids				-	Float32Array	- Header, then CoM centroids, then HGCM centroids (see resultqueue.h)
+	// 		com_centers				-	Float32Array	- Center of mass centroids (X, Y, intensity of each, part of centroids)
+	//		hgcm_centers			-	Float32Array	- HGCM method centroids (same)
+	//		com_count				-	Number		- Number of CoM centroids
+	//		hgcm_count				-	Number		- Number of HGCM centroids
 	//		computation_time		-	Float		- Time to calculate centroids (ms)
 	//		is_led_on				- 	Boolean		- Whether IR LED was on in image
 	//		avg_led_intensity		-	Float		- Average intensity of pixels in LED region
 	//		avg_noise_intensity		-	Float		- Average intensity of pixels in noise region
-
-	// First add the center of mass (CoM) centroids
-	Napi::Array centroidList = Napi::Array::New(env);
-	int centroidCounter = 0; // To keep track of how many center were found
-	for (int center = 0; center < img.Centroids[0].width(); center++) {
-		// Make sure x value is not 0 (i.e. make sure it's a real centroid)
-		if (img.Centroids(0, center, 0) > 0) {
-			Napi::Array spot = Napi::Array::New(env, 2); // centroid's coordinates
-
-			float xCenter = img.Centroids(0, center, 0);
-			float yCenter = img.Centroids(0, center, 1);
-			float avgInt = img.Centroids(0, center, 2);
-			// Account for offsets
-			xCenter -= img.xLowerBound;
-			yCenter -= img.yLowerBound;
-			spot.Set(Napi::Number::New(env, 0), Napi::Number::New(env, xCenter));
-			spot.Set(Napi::Number::New(env, 1), Napi::Number::New(env, yCenter));
-			// Also include average pixel intensity
-			spot.Set(Napi::Number::New(env, 2), Napi::Number::New(env, avgInt));
-
-			// Add spot to centroidList
-			centroidList.Set(centroidCounter, spot);
-			centroidCounter++;
-		}
-	}
-	centroidResults["com_centers"] = centroidList;
-
-	// Next add the hybrid gradient CoM (HGCM) method centroids
-	centroidList = Napi::Array::New(env);
-	centroidCounter = 0; // To keep track of how many center were found
-	for (int center = 0; center < img.Centroids[1].width(); center++) {
-		// Make sure x value is not 0 (i.e. make sure it's a real centroid)
-		if (img.Centroids(1, center, 0) > 0) {
-			Napi::Array spot = Napi::Array::New(env, 2); // centroid's coordinates
-
-			float xCenter = img.Centroids(1, center, 0);
-			float yCenter = img.Centroids(1, center, 1);
-			float avgInt = img.Centroids(1, center, 2);
-			// Account for offsets
-			xCenter -= img.xLowerBound;
-			yCenter -= img.yLowerBound;
-			spot.Set(Napi::Number::New(env, 0), Napi::Number::New(env, xCenter));
-			spot.Set(Napi::Number::New(env, 1), Napi::Number::New(env, yCenter));
-			// Also include average pixel intensity
-			spot.Set(Napi::Number::New(env, 2), Napi::Number::New(env, avgInt));
-
-			// Add spot to centroidList
-			centroidList.Set(centroidCounter, spot);
-			centroidCounter++;
-		}
-	}
-	centroidResults["hgcm_centers"] = centroidList;
+	//		region_table_resizes	-	Number		- Times the region table had to grow since startup
+	//		results_dropped			-	Number		- Results the acquisition thread dropped because JS fell behind
+	//		frame_number			-	Number		- Camera's number for the frame (gaps are frames that were skipped)
+	//		image_buffer			-	Buffer		- Preview image (RGBA), only on frames a preview was made of
+	//		preview_width			-	Number		- Width of the preview image
+	//		preview_height			-	Number		- Height of the preview image
+	//		preview_scale			-	Number		- Image pixels per preview pixel, each way
+
+	// Copy every centroid into one Float32Array, and give each method a view of its part
+	// (Offsets already accounted for)
+	size_t centroidBytes = result.centroids.size() * sizeof(float);
+	Napi::ArrayBuffer centroidBuffer = Napi::ArrayBuffer::New(env, centroidBytes);
+	memcpy(centroidBuffer.Data(), result.centroids.data(), centroidBytes);
+	size_t CoMOffset = CentroidHeaderSize * sizeof(float);
+	size_t HGCMOffset = CoMOffset + FloatsPerCentroid * result.CoMCount * sizeof(float);
+	centroidResults["centroids"] = Napi::Float32Array::New(env, result.centroids.size(), centroidBuffer, 0);
+	centroidResults["com_centers"] = Napi::Float32Array::New(env, FloatsPerCentroid * result.CoMCount, centroidBuffer, CoMOffset);
+	centroidResults["hgcm_centers"] = Napi::Float32Array::New(env, FloatsPerCentroid * result.HGCMCount, centroidBuffer, HGCMOffset);
+	centroidResults["com_count"] = Napi::Number::New(env, result.CoMCount);
+	centroidResults["hgcm_count"] = Napi::Number::New(env, result.HGCMCount);
 
 	// Add the other important values
-	centroidResults["computation_time"] = Napi::Number::New(env, img.computationTime);
-	centroidResults["is_led_on"] = Napi::Boolean::New(env, img.isLEDon);
-	centroidResults["avg_led_intensity"] = Napi::Number::New(env, img.LEDIntensity / img.LEDCount);
-	centroidResults["avg_noise_intensity"] = Napi::Number::New(env, img.NoiseIntensity / img.NoiseCount);
-	centroidResults["image_buffer"] = Napi::Buffer<unsigned char>::Copy(env, camera.buffer.data(), camera.buffer.size());
+	centroidResults["computation_time"] = Napi::Number::New(env, result.computationTime);
+	centroidResults["is_led_on"] = Napi::Boolean::New(env, result.isLEDOn);
+	centroidResults["avg_led_intensity"] = Napi::Number::New(env, result.avgLEDIntensity);
+	centroidResults["avg_noise_intensity"] = Napi::Number::New(env, result.avgNoiseIntensity);
+	centroidResults["region_table_resizes"] = Napi::Number::New(env, result.regionTableResizes);
+	centroidResults["results_dropped"] = Napi::Number::New(env, results.droppedCount());
+	centroidResults["frame_number"] = Napi::Number::New(env, result.frameNumber);
+	// Preview image, only on frames PreviewStage made one of
+	if (result.hasPreview) {
+		centroidResults["image_buffer"] = previewBuffer(env, result.buffer);
+		centroidResults["preview_width"] = Napi::Number::New(env, result.previewWidth);
+		centroidResults["preview_height"] = Napi::Number::New(env, result.previewHeight);
+		centroidResults["preview_scale"] = Napi::Number::New(env, result.previewScale);
+	}
 
 	// Send message to JavaScript with packaged results
 	eventEmitter.Call(
@@ -640,42 +763,528 @@ void sendCentroids() {
 	);
 }
 
+// Centroid a frame of the ring
+// (imageLock must be held)
+void centroidFrame(RingFrame& frame) {
+	int nRet;
+	// Lock the image memory so it's not overwritten while centroiding
+	// (Centroid reads the image straight from pMem, so it stays locked until centroiding is done)
+	nRet = is_LockSeqBuf(hCam, IS_IGNORE_PARAMETER, frame.pMem);
+	if (nRet != IS_SUCCESS) {
+		std::cout << "Failed to lock image: " << GetErrorFromCode(nRet) << std::endl;
+	}
+	// The camera may have put a newer frame in the memory before it was locked
+	UEYEIMAGEINFO imageInfo;
+	if (is_GetImageInfo(hCam, frame.memID, &imageInfo, sizeof(imageInfo)) == IS_SUCCESS) {
+		frame.frameNumber = imageInfo.u64FrameNumber;
+	}
+	// Get image pitch
+	int pPitch;
+	is_GetImageMemPitch(hCam, &pPitch);
+	// Centroid
+	img.centroid(frame.pMem, pPitch);
+	// Make the live view's preview image, if one is due
+	previewStage.render(camera.buffer, frame.pMem, pPitch, camera.width, camera.height, camera.bitDepth);
+	// Save raw frame (if recording) before the memory can be overwritten
+	recorder.record(frame.pMem, pPitch, img.xLowerBound, img.yLowerBound,
+		img.xUpperBound - img.xLowerBound, img.yUpperBound - img.yLowerBound, img.isLEDon);
+	// Unlock the image memory
+	nRet = is_UnlockSeqBuf(hCam, IS_IGNORE_PARAMETER, frame.pMem);
+	if (nRet != IS_SUCCESS) {
+		std::cout << "Failed to unlock image: " << GetErrorFromCode(nRet) << std::endl;
+	}
+}
+
+// Find the memories the camera has written new frames into since the last call
+void findNewFrames() {
+	for (int i = 0; i < frameRing.size(); i++) {
+		RingFrame& frame = frameRing.frames[i];
+		UEYEIMAGEINFO imageInfo;
+		if (is_GetImageInfo(hCam, frame.memID, &imageInfo, sizeof(imageInfo)) != IS_SUCCESS) continue;
+		if (imageInfo.u64FrameNumber != frame.frameNumber) {
+			frameRing.frameWritten(&frame, imageInfo.u64FrameNumber);
+		}
+	}
+}
+
 // Check for messages
 void CheckMessages(const Napi::CallbackInfo& info) {
-	int nRet;
 	MSG msg = { }; // To store message info
 	// Check if there is a message in queue, return if not
 	if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-		// Check if the message is from the camera
-		if (msg.message == IS_UEYE_MESSAGE) {
-			// Check if the message is a frame event
-			if (msg.wParam == IS_FRAME) {
-				// Lock the image memory so it's not overwritten while centroiding
-				nRet = is_LockSeqBuf(hCam, IS_IGNORE_PARAMETER, camera.pMem);
-				if (nRet != IS_SUCCESS) {
-					std::cout << "Failed to lock image: " << GetErrorFromCode(nRet) << std::endl;
-				}
-				// Get image pitch
-				int pPitch;
-				is_GetImageMemPitch(hCam, &pPitch);
-				// Centroid
-				img.centroid(camera.buffer, camera.pMem, pPitch);
-				// Unlock the image memory
-				nRet = is_UnlockSeqBuf(hCam, IS_IGNORE_PARAMETER, camera.pMem);
-				if (nRet != IS_SUCCESS) {
-					std::cout << "Failed to unlock image: " << GetErrorFromCode(nRet) << std::endl;
-				}
+		// Check if the message is a frame event from the camera
+		if (msg.message == IS_UEYE_MESSAGE && msg.wParam == IS_FRAME) {
+			std::lock_guard<std::mutex> guard(imageLock);
+			// Centroid every new frame, oldest first
+			findNewFrames();
+			RingFrame* frame;
+			while ((frame = frameRing.takeFrame()) != nullptr) {
+				centroidFrame(*frame);
 				// Return calculated centers
-				sendCentroids();
+				directResult.copy(img, camera.buffer, previewStage);
+				directResult.frameNumber = frame->frameNumber;
+				sendCentroids(directResult);
+				frameRing.release(frame);
+			}
+		}
+	}
+}
+
+// Send every queued result to JavaScript
+// (Called on the JS thread through resultDelivery)
+void deliverResults(Napi::Env env, Napi::Function emit) {
+	deliveryPending = false; // (Results queued from here on need another call)
+	FrameResult* result;
+	while ((result = results.front()) != nullptr) {
+		sendCentroids(*result);
+		results.pop();
+	}
+}
+
+// Queue the results of the frame just centroided, and ask the JS thread to take them
+// Never waits for JS: if the queue is full the results are dropped (and counted)
+// (Called on the acquisition thread with imageLock held)
+void queueResults(unsigned long long frameNumber) {
+	framesCentroided++;
+	FrameResult* result = results.reserve();
+	if (result == nullptr) {
+		previewStage.take(); // (So the preview doesn't end up with a later frame)
+		return;
+	}
+	result->copy(img, camera.buffer, previewStage);
+	result->frameNumber = frameNumber;
+	results.publish();
+	// Only one delivery call needs to be waiting at a time
+	if (!deliveryPending.exchange(true)) {
+		if (resultDelivery.NonBlockingCall(deliverResults) != napi_ok) {
+			deliveryPending = false;
+		}
+	}
+}
+
+// Acquisition thread loop, waits for the camera's frame event and centroids each frame
+void acquireFrames() {
+	while (acquiring) {
+		// (Times out now and then to check whether to stop)
+		if (WaitForSingleObject(frameEvent, 100) != WAIT_OBJECT_0) continue;
+
+		// Centroid every new frame, oldest first
+		std::lock_guard<std::mutex> guard(imageLock);
+		findNewFrames();
+		RingFrame* frame;
+		while ((frame = frameRing.takeFrame()) != nullptr) {
+			centroidFrame(*frame);
+			queueResults(frame->frameNumber);
+			frameRing.release(frame);
+		}
+	}
+}
+
+// Stop the acquisition thread (if running) and wait for it to finish
+void stopAcquisition() {
+	if (!acquisitionThread.joinable()) return;
+	acquiring = false;
+	acquisitionThread.join();
+	resultDelivery.Release();
+	is_DisableEvent(hCam, IS_SET_EVENT_FRAME);
+	is_ExitEvent(hCam, IS_SET_EVENT_FRAME);
+	CloseHandle(frameEvent);
+	frameEvent = NULL;
+}
+
+// Start centroiding frames on a separate thread
+// Results are sent with the emitter ("new-image") as they are ready, so checkMessages() is not needed
+// initEmitter() has to be called first
+// Returns true unless the emitter isn't set up or frames can't be waited for
+Napi::Boolean StartAcquisition(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (eventEmitter.IsEmpty() || !camera.connected) {
+		return Napi::Boolean::New(env, false);
+	}
+	stopAcquisition();
+
+	// Have the camera signal an event for each frame
+	frameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	int nRet = is_InitEvent(hCam, frameEvent, IS_SET_EVENT_FRAME);
+	if (nRet == IS_SUCCESS) nRet = is_EnableEvent(hCam, IS_SET_EVENT_FRAME);
+	if (nRet != IS_SUCCESS) {
+		std::cout << "Enable frame event failed with error " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
+		CloseHandle(frameEvent);
+		frameEvent = NULL;
+		return Napi::Boolean::New(env, false);
+	}
+	resultDelivery = Napi::ThreadSafeFunction::New(env, eventEmitter.Value(), "camera-results", 0, 1);
+	acquiring = true;
+	acquisitionThread = std::thread(acquireFrames);
+
+	return Napi::Boolean::New(env, true);
+}
+
+// Stop centroiding frames on a separate thread
+void StopAcquisition(const Napi::CallbackInfo& info) {
+	stopAcquisition();
+}
+
+// Get counts of frames centroided by the acquisition thread, and of frames that were skipped
+// Returns object with
+//		frames_centroided		-	Number	-	Frames centroided by the acquisition thread
+//		results_sent			-	Number	-	Results queued for JS
+//		results_dropped			-	Number	-	Results JS didn't take in time
+//		frames_skipped			-	Number	-	Frame numbers that were never centroided (since the image memories were allocated)
+//		skipped_frame_numbers	-	Array	-	The most recent skipped frame numbers
+//		previews_made			-	Number	-	Preview images made (they are rate limited)
+//		previews_reused			-	Number	-	Previews sent in a Buffer given back with returnPreview()
+Napi::Object GetAcquisitionStats(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	Napi::Object stats = Napi::Object::New(env);
+	stats["frames_centroided"] = Napi::Number::New(env, framesCentroided);
+	stats["results_sent"] = Napi::Number::New(env, results.resultCount());
+	stats["results_dropped"] = Napi::Number::New(env, results.droppedCount());
+	stats["frames_skipped"] = Napi::Number::New(env, frameRing.skippedCount());
+	std::vector<unsigned long long> skippedFrames = frameRing.recentSkippedFrames();
+	Napi::Array skippedList = Napi::Array::New(env, skippedFrames.size());
+	for (int i = 0; i < skippedFrames.size(); i++) {
+		skippedList.Set(i, Napi::Number::New(env, skippedFrames[i]));
+	}
+	stats["skipped_frame_numbers"] = skippedList;
+	stats["previews_made"] = Napi::Number::New(env, previewStage.renderedCount());
+	stats["previews_reused"] = Napi::Number::New(env, previewsReused);
+
+	return stats;
+}
+
+// Turn the live view's preview images on or off
+// (Off while nobody is looking, so frames only cost centroiding)
+// @param {Boolean}
+Napi::Boolean SetPreviewEnabled(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsBoolean()) {
+		previewStage.enabled = info[0].ToBoolean();
+	}
+
+	return Napi::Boolean::New(env, previewStage.enabled);
+}
+
+// Set the most preview images made per second (0 makes one of every frame)
+// @param {Number} - previews per second
+Napi::Number SetPreviewRate(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		double rate = info[0].ToNumber().DoubleValue();
+		if (rate >= 0) previewStage.maxRate = rate;
+	}
+
+	return Napi::Number::New(env, previewStage.maxRate);
+}
+
+// Set how much preview images are downscaled (1, 2 or 4 image pixels per preview pixel, each way)
+// @param {Number} - scale
+Napi::Number SetPreviewScale(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info[0].IsNumber()) {
+		previewStage.setScale(info[0].ToNumber().Int32Value());
+	}
+
+	return Napi::Number::New(env, previewStage.scale);
+}
+
+// Send a full size preview image with the next frame, even if previews are off
+// (For saving a single shot)
+void RequestFullImage(const Napi::CallbackInfo& info) {
+	std::lock_guard<std::mutex> guard(imageLock);
+	previewStage.requestFullImage();
+}
+
+// Give back the image_buffer of a result once JS is done with it, so a later preview can be sent in it
+// (JS must not use the Buffer after this. Buffers that aren't given back are just garbage collected)
+// @param {Buffer}
+void ReturnPreview(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() != 1 || !info[0].IsBuffer()) {
+		Napi::Error::New(env, "returnPreview requires a Buffer").
+			ThrowAsJavaScriptException();
+		return;
+	}
+	Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char> >();
+	if (previewBuffers.size() >= PreviewBuffersKept) return;
+	// (A Buffer given back twice would otherwise be sent with two results)
+	for (int i = 0; i < previewBuffers.size(); i++) {
+		if (previewBuffers[i].Value().StrictEquals(buffer)) return;
+	}
+	previewBuffers.push_back(Napi::Persistent(buffer));
+}
+
+
+// Start saving each raw frame (AoI only) to a ring file
+// Arguments are (file path, number of frames the file holds)
+// Once the file is full, the oldest frames are overwritten
+// Must be called after applyDefaultSettings()
+// Returns true if the file was made
+Napi::Boolean StartRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber()) {
+		Napi::Error::New(env, "startRecording requires a file path and a number of frames").
+			ThrowAsJavaScriptException();
+		return Napi::Boolean::New(env, false);
+	}
+	std::string path = info[0].ToString().Utf8Value();
+	int frameCount = (int)info[1].ToNumber().Int32Value();
+
+	bool started = recorder.start(path, frameCount, camera.width, camera.height, camera.bitDepth);
+	if (!started) {
+		std::cout << "Could not start recording to " << path << std::endl;
+	}
+
+	return Napi::Boolean::New(env, started);
+}
+
+// Stop saving raw frames and close the file
+// Returns object with number of frames recorded and dropped (because the disk fell behind)
+Napi::Object StopRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
+
+	Napi::Object results = Napi::Object::New(env);
+	results["frames_recorded"] = Napi::Number::New(env, recorder.framesRecorded());
+	results["frames_dropped"] = Napi::Number::New(env, recorder.framesDropped());
+	recorder.stop();
+
+	return results;
+}
+
+// Centroids a recording again on a background thread (so JavaScript isn't blocked)
+class RecentroidWorker : public Napi::AsyncWorker
+{
+public:
+	RecentroidWorker(Napi::Env env, std::string recordingPath)
+		: Napi::AsyncWorker(env), deferred(Napi::Promise::Deferred::New(env)), path(recordingPath)
+	{
+	}
+
+	Napi::Promise::Deferred deferred;
+	std::string path;
+	Recentroider recentroider;
+	int frameCount = 0;
+
+	void Execute()
+	{
+		RecordingReader recording;
+		if (!recording.open(path)) {
+			SetError("Could not read recording " + path);
+			return;
+		}
+		frameCount = recording.frameCount();
+		recentroider.run(recording);
+	}
+
+	void OnOK()
+	{
+		Napi::Env env = Env();
+		int binSize = recentroider.settings.binSize;
+
+		Napi::Object output = Napi::Object::New(env);
+		output["frame_count"] = Napi::Number::New(env, frameCount);
+		output["computation_time"] = Napi::Number::New(env, recentroider.computationTime);
+		Napi::Uint8Array frameLEDOn = Napi::Uint8Array::New(env, frameCount);
+		memcpy(frameLEDOn.Data(), recentroider.frameLEDOn.data(), frameCount);
+		output["frame_led_on"] = frameLEDOn;
+
+		Napi::Array resultList = Napi::Array::New(env);
+		for (int t = 0; t < recentroider.results.size(); t++) {
+			RecentroidResult& result = recentroider.results[t];
+			Napi::Object resultObject = Napi::Object::New(env);
+			resultObject["threshold"] = Napi::Number::New(env, result.threshold);
+			resultObject["ir_off_electrons"] = Napi::Number::New(env, result.IROffCount);
+			resultObject["ir_on_electrons"] = Napi::Number::New(env, result.IROnCount);
+
+			// Centroids packed as [X, Y, intensity, method] (method is 0 for CoM, 1 for HGCM)
+			Napi::Float32Array centroids = Napi::Float32Array::New(env, 4 * result.centroids.size());
+			for (int i = 0; i < result.centroids.size(); i++) {
+				centroids[4*i] = result.centroids[i].X;
+				centroids[4*i + 1] = result.centroids[i].Y;
+				centroids[4*i + 2] = result.centroids[i].intensity;
+				centroids[4*i + 3] = result.centroids[i].method;
+			}
+			resultObject["centroids"] = centroids;
+			Napi::Uint32Array frameStart = Napi::Uint32Array::New(env, result.frameStart.size());
+			memcpy(frameStart.Data(), result.frameStart.data(), result.frameStart.size() * sizeof(unsigned int));
+			resultObject["frame_start"] = frameStart;
+
+			Napi::Uint32Array IROffImage = Napi::Uint32Array::New(env, binSize * binSize);
+			memcpy(IROffImage.Data(), result.IROffImage.data(), result.IROffImage.size() * sizeof(unsigned int));
+			resultObject["ir_off_image"] = IROffImage;
+			Napi::Uint32Array IROnImage = Napi::Uint32Array::New(env, binSize * binSize);
+			memcpy(IROnImage.Data(), result.IROnImage.data(), result.IROnImage.size() * sizeof(unsigned int));
+			resultObject["ir_on_image"] = IROnImage;
+
+			resultList.Set(t, resultObject);
+		}
+		output["results"] = resultList;
+
+		deferred.Resolve(output);
+	}
+
+	void OnError(const Napi::Error& error)
+	{
+		deferred.Reject(error.Value());
+	}
+};
+
+// Centroid every frame of a recording (made with startRecording()) again with new settings
+// Arguments are (file path, options), options can have
+//		thresholds	-	Array	-	Thresholds to try (default [20]), all done in one pass over the file
+//		min_pix		-	Number	-	Smallest region to centroid (default 3)
+//		max_pix		-	Number	-	Regions with this many pixels use HGCM (default 120)
+//		use_hybrid	-	Boolean	-	Whether to use HGCM for large regions (default true)
+//		threads		-	Number	-	Number of threads (default every core)
+//		bin_size	-	Number	-	Size of the accumulated images (default 1024)
+// Returns a Promise of the results (see camera_readme.md)
+Napi::Value RecentroidRecording(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::Error::New(env, "recentroidRecording requires a file path").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+
+	RecentroidWorker* worker = new RecentroidWorker(env, info[0].ToString().Utf8Value());
+	RecentroidSettings& settings = worker->recentroider.settings;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].ToObject();
+		if (options.Has("thresholds") && options.Get("thresholds").IsArray()) {
+			Napi::Array thresholds = options.Get("thresholds").As<Napi::Array>();
+			settings.thresholds.clear();
+			for (int i = 0; i < thresholds.Length(); i++) {
+				settings.thresholds.push_back(thresholds.Get(i).ToNumber().Uint32Value());
 			}
 		}
+		if (options.Get("min_pix").IsNumber()) settings.minPix = options.Get("min_pix").ToNumber().Int32Value();
+		if (options.Get("max_pix").IsNumber()) settings.maxPix = options.Get("max_pix").ToNumber().Int32Value();
+		if (options.Get("use_hybrid").IsBoolean()) settings.useHybrid = options.Get("use_hybrid").ToBoolean();
+		if (options.Get("threads").IsNumber()) settings.threads = options.Get("threads").ToNumber().Int32Value();
+		if (options.Get("bin_size").IsNumber()) settings.binSize = options.Get("bin_size").ToNumber().Int32Value();
+	}
+
+	Napi::Promise promise = worker->deferred.Promise();
+	worker->Queue(); // (Deletes itself when done)
+	return promise;
+}
+
+// Add a frame's centroids to an accumulated image (in place, see accumulatedimage.h)
+// Arguments are (image, centroids, bin size, AoI width, AoI height)
+//		image		-	Uint32Array		-	Accumulated image (bin size x bin size, row by row)
+//		centroids	-	Float32Array	-	Packed centroids of the frame (centroid_results.centroids)
+// (Doesn't use the camera, so it can be called from any window)
+// Returns the number of centroids that landed in the image
+Napi::Value AccumulateCentroids(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 5 || !info[0].IsTypedArray() || !info[1].IsTypedArray()
+		|| info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array
+		|| info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+		Napi::TypeError::New(env, "accumulateCentroids requires (Uint32Array, Float32Array, binSize, AoIWidth, AoIHeight)").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	Napi::Uint32Array image = info[0].As<Napi::Uint32Array>();
+	Napi::Float32Array centroids = info[1].As<Napi::Float32Array>();
+	int binSize = info[2].ToNumber().Int32Value();
+	double AoIWidth = info[3].ToNumber().DoubleValue();
+	double AoIHeight = info[4].ToNumber().DoubleValue();
+	if (AoIWidth <= 0) AoIWidth = 1;
+	if (AoIHeight <= 0) AoIHeight = 1;
+
+	// Header is values per centroid, CoM count, HGCM count (see resultqueue.h)
+	const float* packed = centroids.Data();
+	if (binSize <= 0 || image.ElementLength() < (size_t)binSize * binSize || centroids.ElementLength() < CentroidHeaderSize) {
+		return Napi::Number::New(env, 0);
+	}
+	int floatsPerCentroid = (int)packed[0];
+	int count = (int)packed[1] + (int)packed[2];
+	if (floatsPerCentroid < 2 || centroids.ElementLength() < CentroidHeaderSize + (size_t)count * floatsPerCentroid) {
+		return Napi::Number::New(env, 0);
+	}
+	unsigned int binned = accumulateCentroids(image.Data(), binSize, packed + CentroidHeaderSize, count, floatsPerCentroid, AoIWidth, AoIHeight);
+
+	return Napi::Number::New(env, binned);
+}
+
+// Render an accumulated image into the pixels of an ImageData (see imagedisplay.h)
+// Arguments are (output, image, bin size, contrast, mapping, negative[, subtract])
+//		output		-	Uint8ClampedArray	-	ImageData.data of a bin size x bin size ImageData (overwritten)
+//		image		-	Uint32Array			-	Accumulated image (bin size x bin size, row by row)
+//		mapping		-	String				-	"linear", "sqrt" or "log"
+//		negative	-	Boolean				-	Whether to show only negative differences (difference images)
+//		subtract	-	Uint32Array			-	Image to take away from image first (difference images)
+// (Doesn't use the camera, so it can be called from any window)
+// Returns true if the image was rendered
+Napi::Value RenderAccumulatedImage(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env(); // Napi local environment
+
+	if (info.Length() < 6 || !info[0].IsTypedArray() || !info[1].IsTypedArray() || !info[4].IsString()
+		|| info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_clamped_array
+		|| info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array) {
+		Napi::TypeError::New(env, "renderAccumulatedImage requires (Uint8ClampedArray, Uint32Array, binSize, contrast, mapping, negative[, Uint32Array])").
+			ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	std::string mappingName = info[4].As<Napi::String>().Utf8Value();
+	DisplayMapping mapping;
+	if (mappingName == "linear") {
+		mapping = DisplayMapping::Linear;
+	} else if (mappingName == "sqrt") {
+		mapping = DisplayMapping::Sqrt;
+	} else if (mappingName == "log") {
+		mapping = DisplayMapping::Log;
+	} else {
+		Napi::TypeError::New(env, "renderAccumulatedImage mapping has to be \"linear\", \"sqrt\" or \"log\"").ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	Napi::Uint8Array output = info[0].As<Napi::Uint8Array>();
+	Napi::Uint32Array image = info[1].As<Napi::Uint32Array>();
+	int binSize = info[2].ToNumber().Int32Value();
+	double contrast = info[3].ToNumber().DoubleValue();
+	bool negative = info[5].ToBoolean().Value();
+	const unsigned int* subtract = nullptr;
+	size_t count = (binSize > 0) ? (size_t)binSize * binSize : 0;
+	if (info.Length() > 6 && info[6].IsTypedArray()) {
+		if (info[6].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array) {
+			Napi::TypeError::New(env, "renderAccumulatedImage subtract image has to be a Uint32Array").ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+		Napi::Uint32Array subtractImage = info[6].As<Napi::Uint32Array>();
+		if (subtractImage.ElementLength() < count) return Napi::Boolean::New(env, false);
+		subtract = subtractImage.Data();
+	}
+	if (count == 0 || image.ElementLength() < count || output.ElementLength() < 4 * count) {
+		return Napi::Boolean::New(env, false);
 	}
+	imageDisplay.setMapping(mapping, contrast);
+	imageDisplay.render(output.Data(), image.Data(), subtract, (int)count, negative);
+
+	return Napi::Boolean::New(env, true);
 }
 
 // Close the camera
 void Close(const Napi::CallbackInfo& info) {
 	int nRet;
 
+	// Stop centroiding and finish writing recorded frames
+	stopAcquisition();
+	recorder.stop();
+
 	// Disable messages
 	nRet = is_EnableMessage(hCam, IS_FRAME, NULL);
 	std::cout << "\nDisable messages - Code " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
@@ -688,7 +1297,14 @@ void Close(const Napi::CallbackInfo& info) {
 	nRet = is_ExitCamera(hCam);
 	std::cout << "Exit camera - Code " << nRet << ": " << GetErrorFromCode(nRet) << std::endl;
 
+	// (is_ExitCamera() freed the image memories, so the bit depth can be changed again)
+	{
+		std::lock_guard<std::mutex> guard(imageLock);
+		frameRing.clear();
+	}
+
 	camera.connected = false;
+	previewBuffers.clear();
 }
 
 // Set up emitter to communicate with JavaScript
@@ -702,6 +1318,7 @@ void InitEmitter(const Napi::CallbackInfo& info) {
 // returns buffer
 Napi::Value InitBuffer(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env(); // Napi local environment
+	std::lock_guard<std::mutex> guard(imageLock);
 
 	// Initialize buffer in camera object
 	camera.buffer.assign(4 * camera.imageLength, 0);
@@ -719,6 +1336,15 @@ Napi::Value InitBuffer(const Napi::CallbackInfo& info) {
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	// Fill exports object with addon functions
 	exports["useHybridMethod"] = Napi::Function::New(env, UseHybridMethod);
+	exports["useRunLengthLabeling"] = Napi::Function::New(env, UseRunLengthLabeling);
+	exports["setCentroidThreads"] = Napi::Function::New(env, SetCentroidThreads);
+	exports["startRecording"] = Napi::Function::New(env, StartRecording);
+	exports["stopRecording"] = Napi::Function::New(env, StopRecording);
+	exports["recentroidRecording"] = Napi::Function::New(env, RecentroidRecording);
+	exports["accumulateCentroids"] = Napi::Function::New(env, AccumulateCentroids);
+	exports["renderAccumulatedImage"] = Napi::Function::New(env, RenderAccumulatedImage);
+	exports["setBitDepth"] = Napi::Function::New(env, SetBitDepth);
+	exports["setFrameBufferCount"] = Napi::Function::New(env, SetFrameBufferCount);
 	exports["createWinAPIWindow"] = Napi::Function::New(env, CreateWinAPIWindow);
 	exports["connect"] = Napi::Function::New(env, Connect);
 	exports["getInfo"] = Napi::Function::New(env, GetInfo);
@@ -734,6 +1360,14 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	exports["startCapture"] = Napi::Function::New(env, StartCapture);
 	exports["enableMessages"] = Napi::Function::New(env, EnableMessages);
 	exports["checkMessages"] = Napi::Function::New(env, CheckMessages);
+	exports["startAcquisition"] = Napi::Function::New(env, StartAcquisition);
+	exports["stopAcquisition"] = Napi::Function::New(env, StopAcquisition);
+	exports["getAcquisitionStats"] = Napi::Function::New(env, GetAcquisitionStats);
+	exports["setPreviewEnabled"] = Napi::Function::New(env, SetPreviewEnabled);
+	exports["setPreviewRate"] = Napi::Function::New(env, SetPreviewRate);
+	exports["setPreviewScale"] = Napi::Function::New(env, SetPreviewScale);
+	exports["requestFullImage"] = Napi::Function::New(env, RequestFullImage);
+	exports["returnPreview"] = Napi::Function::New(env, ReturnPreview);
 	exports["close"] = Napi::Function::New(env, Close);
 	exports["initEmitter"] = Napi::Function::New(env, InitEmitter);
 	exports["initBuffer"] = Napi::Function::New(env, InitBuffer);
@@ -0,0 +1,631 @@
+#include "centroid.h"
+#include "simulation.h"
+#include "fastsimulation.h"
+#include "triggerschedule.h"
+#include "recorder.h"
+#include "framering.h"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+
+Headless centroiding benchmark (built as its own executable by binding.gyp)
+
+Centroids simulated images (the same ones camera_mac.cc makes) with each method
+	and prints one line of JSON per method with the frame rate, latency
+	percentiles and allocations per frame, so runs can be compared over time
+With --accuracy, each method's centroids are instead matched against the true
+	spot centers from the simulator, and the detection rate, false positives,
+	RMS position error and time per frame are printed (for hgcm, that's every
+	centroid the app would get: the CoM centroids of the small regions and the
+	HGCM centroids of the large ones)
+A list of spot counts (e.g. --spots 25,50,100,200) runs everything once per
+	spot count, to see how speed and accuracy change with spot density
+A list of thread counts (e.g. --threads 1,2,4, or --thread-sweep N for 1 ... N)
+	runs everything once per thread count, to see how labeling scales with cores
+Each hgcm line also has hgcm_mean_ms, the time spent on the large regions alone
+	(zero crossings and merging), and with --gradient both hgcm is run with the
+	SSE2 and the scalar zero-crossing test (gradient.h), to see the speedup
+With --ring N, a simulated camera thread instead writes a frame every --period ms
+	into a ring of N image memories (the same FrameRing the camera addons use),
+	and the frames are centroided in order as they come, so the frames skipped
+	when centroiding can't keep up with the trigger are counted
+With --simulation-speed, nothing is centroided, and the frame rate of each
+	simulator (ImageSimulator, FastImageSimulator, and FastImageSimulator
+	pregenerating on a background thread) is printed instead
+With --check-allocations, every distinct image is centroided once before
+	timing, and the benchmark exits with 1 if any method still allocates
+	in the timed frames (centroiding is meant to reuse all its storage once
+	it has grown to the busiest frame)
+
+Usage: centroid_benchmark [options]
+	--frames N			Number of timed frames per method (default 500)
+	--warmup N			Number of untimed frames before timing (default 20)
+	--distinct N		Number of different simulated images to cycle through (default 50)
+	--spots N[,N...]	Base number of spots per image (default 55)
+	--spot-variation N	Spots per image vary by up to this many (default 10)
+	--width N			Image width (default 1024)
+	--height N			Image height (default 768)
+	--aoi WxH			Size of the centroiding AoI, centered in the image (default whole image)
+	--threshold N		Centroiding threshold (default 20)
+	--threads N[,N...]	Number of centroiding threads (default 1)
+	--thread-sweep N	Same as --threads 1,2,...,N (0 goes up to the number of cores)
+	--bit-depth N		8, 10, 12 or 16 (default 8, images are scaled up from 8 bits)
+	--rle				Use run-length labeling
+	--method M			com, hgcm or both (default both)
+	--gradient G		Zero-crossing test of hgcm: sse2, scalar or both (default sse2, which is the
+						scalar loop too on builds without SSE2, not with --accuracy or --ring)
+	--accuracy			Report accuracy against the true spot centers (each distinct image is used once)
+	--match-radius R	Centroids within R pixels of a true center count as finding it (default 2)
+	--record FILE		Also record every timed frame to a ring file (like startRecording())
+	--record-slots N	Number of frames the ring file holds (default 1000)
+	--ring N			Centroid frames from a ring of N image memories as a camera writes them
+	--period MS			Trigger period of the simulated camera with --ring (default 50)
+	--jitter MS			Each trigger is moved randomly by up to this much (default 0)
+	--burst N,MS		Triggers come in bursts of N, with an extra MS pause after each burst
+	--simulator S		classic (ImageSimulator) or fast (FastImageSimulator) to make the images (default classic)
+	--simulation-speed	Time the simulators instead of centroiding
+	--check-allocations	Fail if centroiding allocates once warmed up (not with --accuracy, --ring or --simulation-speed)
+
+*/
+
+// Count every allocation, so steady-state allocations per frame can be reported
+// Every form of new and delete is replaced, so they all pair up with malloc and free
+// (They aren't inlined, or GCC sees free() called on memory from operator new and warns)
+#if defined(_MSC_VER)
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+std::atomic<long long> allocationCount(0);
+
+void* countedAllocate(size_t size) noexcept
+{
+	allocationCount++;
+	return malloc(size ? size : 1);
+}
+
+BENCHMARK_NOINLINE void* operator new(size_t size)
+{
+	void* p = countedAllocate(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+BENCHMARK_NOINLINE void* operator new[](size_t size)
+{
+	void* p = countedAllocate(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+BENCHMARK_NOINLINE void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+BENCHMARK_NOINLINE void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+struct BenchmarkSettings
+{
+	int frames = 500;
+	int warmup = 20;
+	int distinct = 50;
+	std::vector<int> spotCounts;
+	int spots = 55;			// Spot count being run
+	int spotVariation = 10;
+	int width = 1024;
+	int height = 768;
+	int AoIWidth = 0;		// 0 means whole image
+	int AoIHeight = 0;
+	int threshold = 20;
+	std::vector<int> threadCounts;
+	int threads = 1;		// Thread count being run
+	int bitDepth = 8;
+	bool useRunLength = false;
+	bool accuracy = false;
+	float matchRadius = 2;
+	std::string recordPath;		// Empty means don't record
+	int recordSlots = 1000;
+	int ringSize = 0;		// 0 means don't simulate a camera
+	float period = 50;
+	float jitter = 0;
+	int burstLength = 0;	// 0 means no bursts
+	float burstPause = 0;
+	std::string simulator = "classic";
+	bool simulationSpeed = false;
+	bool checkAllocations = false;
+	std::string method = "both";
+	std::string gradient = "sse2";
+};
+
+// Read command line options into settings
+// Returns false if an option isn't recognized
+bool parseArguments(int argc, char** argv, BenchmarkSettings& settings)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (option == "--rle") {
+			settings.useRunLength = true;
+		} else if (option == "--frames" && hasValue) {
+			settings.frames = atoi(argv[++i]);
+		} else if (option == "--warmup" && hasValue) {
+			settings.warmup = atoi(argv[++i]);
+		} else if (option == "--distinct" && hasValue) {
+			settings.distinct = atoi(argv[++i]);
+		} else if (option == "--record" && hasValue) {
+			settings.recordPath = argv[++i];
+		} else if (option == "--record-slots" && hasValue) {
+			settings.recordSlots = atoi(argv[++i]);
+		} else if (option == "--ring" && hasValue) {
+			settings.ringSize = atoi(argv[++i]);
+		} else if (option == "--period" && hasValue) {
+			settings.period = atof(argv[++i]);
+		} else if (option == "--jitter" && hasValue) {
+			settings.jitter = atof(argv[++i]);
+		} else if (option == "--burst" && hasValue) {
+			if (sscanf(argv[++i], "%d,%f", &settings.burstLength, &settings.burstPause) != 2) return false;
+		} else if (option == "--simulator" && hasValue) {
+			settings.simulator = argv[++i];
+		} else if (option == "--simulation-speed") {
+			settings.simulationSpeed = true;
+		} else if (option == "--check-allocations") {
+			settings.checkAllocations = true;
+		} else if (option == "--accuracy") {
+			settings.accuracy = true;
+		} else if (option == "--match-radius" && hasValue) {
+			settings.matchRadius = atof(argv[++i]);
+		} else if (option == "--spots" && hasValue) {
+			// Comma separated list
+			char* list = argv[++i];
+			while (*list != '\0') {
+				settings.spotCounts.push_back(strtol(list, &list, 10));
+				if (*list == ',') list++;
+				else if (*list != '\0') return false;
+			}
+		} else if (option == "--spot-variation" && hasValue) {
+			settings.spotVariation = atoi(argv[++i]);
+		} else if (option == "--width" && hasValue) {
+			settings.width = atoi(argv[++i]);
+		} else if (option == "--height" && hasValue) {
+			settings.height = atoi(argv[++i]);
+		} else if (option == "--aoi" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &settings.AoIWidth, &settings.AoIHeight) != 2) return false;
+		} else if (option == "--threshold" && hasValue) {
+			settings.threshold = atoi(argv[++i]);
+		} else if (option == "--threads" && hasValue) {
+			// Comma separated list
+			char* list = argv[++i];
+			while (*list != '\0') {
+				settings.threadCounts.push_back(strtol(list, &list, 10));
+				if (*list == ',') list++;
+				else if (*list != '\0') return false;
+			}
+		} else if (option == "--thread-sweep" && hasValue) {
+			int most = atoi(argv[++i]);
+			if (most < 1) most = std::thread::hardware_concurrency();
+			if (most < 1) most = 1;
+			for (int count = 1; count <= most; count++) {
+				settings.threadCounts.push_back(count);
+			}
+		} else if (option == "--bit-depth" && hasValue) {
+			settings.bitDepth = atoi(argv[++i]);
+		} else if (option == "--method" && hasValue) {
+			settings.method = argv[++i];
+		} else if (option == "--gradient" && hasValue) {
+			settings.gradient = argv[++i];
+		} else {
+			return false;
+		}
+	}
+	if (settings.spotCounts.empty()) settings.spotCounts.push_back(settings.spots);
+	if (settings.threadCounts.empty()) settings.threadCounts.push_back(settings.threads);
+	for (int i = 0; i < settings.threadCounts.size(); i++) {
+		if (settings.threadCounts[i] < 1) return false;
+	}
+	if (settings.frames < 1) settings.frames = 1;
+	if (settings.distinct < 1) settings.distinct = 1;
+	if (settings.spotVariation < 1) settings.spotVariation = 1;
+	if (settings.AoIWidth <= 0 || settings.AoIWidth > settings.width) settings.AoIWidth = settings.width;
+	if (settings.AoIHeight <= 0 || settings.AoIHeight > settings.height) settings.AoIHeight = settings.height;
+	if (settings.simulator != "classic" && settings.simulator != "fast") return false;
+	if (settings.gradient != "sse2" && settings.gradient != "scalar" && settings.gradient != "both") return false;
+	if (settings.gradient != "sse2" && (settings.accuracy || settings.ringSize > 0)) return false;
+	if (settings.checkAllocations) {
+		if (settings.accuracy || settings.ringSize > 0 || settings.simulationSpeed) return false;
+		// (Storage only stops growing once the busiest image has been centroided)
+		if (settings.warmup < settings.distinct) settings.warmup = settings.distinct;
+	}
+	return settings.method == "com" || settings.method == "hgcm" || settings.method == "both";
+}
+
+// Value below which fraction of the (sorted) latencies fall
+double percentile(std::vector<double>& sortedLatencies, double fraction)
+{
+	int index = (int)(fraction * (sortedLatencies.size() - 1) + 0.5);
+	return sortedLatencies[index];
+}
+
+// Centroid every frame with one method and print the results as a line of JSON
+// (If recording, each timed frame is also given to the recorder, as camera_mac.cc does)
+// Returns the allocations per timed frame
+double runMethod(BenchmarkSettings& settings, Centroid& img, std::vector<std::vector<char> >& frames, bool useHybrid)
+{
+	FrameRecorder recorder;
+	if (!settings.recordPath.empty() && !recorder.start(settings.recordPath, settings.recordSlots, settings.width, settings.height, settings.bitDepth)) {
+		fprintf(stderr, "Could not record to %s\n", settings.recordPath.c_str());
+	}
+	int pitch = (settings.bitDepth > 8) ? 2 * settings.width : settings.width;
+	img.setHybridMethod(useHybrid);
+
+	for (int i = 0; i < settings.warmup; i++) {
+		img.centroid(frames[i % frames.size()].data(), pitch);
+	}
+
+	std::vector<double> latencies(settings.frames);
+	double hgcmTotal = 0;
+	long long centroidTotal = 0;
+	long long allocationsBefore = allocationCount;
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < settings.frames; i++) {
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		img.centroid(frames[i % frames.size()].data(), pitch);
+		recorder.record(frames[i % frames.size()].data(), pitch, img.xLowerBound, img.yLowerBound,
+			img.xUpperBound - img.xLowerBound, img.yUpperBound - img.yLowerBound, img.isLEDon);
+		std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+		latencies[i] = frameTime.count();
+		hgcmTotal += img.hgcmTime;
+		centroidTotal += img.CCLCount + img.HybridCount;
+	}
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - runStart;
+	long long allocations = allocationCount - allocationsBefore;
+	unsigned long long framesDropped = recorder.framesDropped();
+	recorder.stop();
+
+	std::sort(latencies.begin(), latencies.end());
+	double meanLatency = 0;
+	for (int i = 0; i < settings.frames; i++) {
+		meanLatency += latencies[i] / settings.frames;
+	}
+
+	printf("{\"method\": \"%s\", \"gradient\": \"%s\", \"frames\": %d, \"spots\": %d, \"width\": %d, \"height\": %d, "
+		"\"aoi_width\": %d, \"aoi_height\": %d, \"threshold\": %d, \"threads\": %d, \"bit_depth\": %d, "
+		"\"run_length_labeling\": %s, \"fps\": %.1f, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, "
+		"\"max_ms\": %.4f, \"hgcm_mean_ms\": %.4f, \"allocs_per_frame\": %.3f, \"centroids_per_frame\": %.1f, "
+		"\"recorded\": %s, \"frames_dropped\": %llu}\n",
+		useHybrid ? "hgcm" : "com", useHybrid ? (img.UseScalarGradient ? "scalar" : "sse2") : "none",
+		settings.frames, settings.spots, settings.width, settings.height,
+		settings.AoIWidth, settings.AoIHeight, settings.threshold, settings.threads, settings.bitDepth,
+		settings.useRunLength ? "true" : "false", settings.frames / runTime.count(), meanLatency,
+		percentile(latencies, 0.5), percentile(latencies, 0.99), latencies.back(), hgcmTotal / settings.frames,
+		allocations / (double)settings.frames, centroidTotal / (double)settings.frames,
+		settings.recordPath.empty() ? "false" : "true", framesDropped);
+	fflush(stdout);
+	return allocations / (double)settings.frames;
+}
+
+// Simulate a camera writing a frame into the ring at each trigger (every settings.period ms, with any jitter
+// and bursts), while this thread centroids
+// the frames in order the way the camera addons' acquisition thread does, and print the results as a line of JSON
+void runRing(BenchmarkSettings& settings, Centroid& img, std::vector<std::vector<char> >& frames, bool useHybrid)
+{
+	int pitch = (settings.bitDepth > 8) ? 2 * settings.width : settings.width;
+	img.setHybridMethod(useHybrid);
+
+	FrameRing frameRing;
+	std::vector<std::vector<char> > memories(settings.ringSize, std::vector<char>(frames[0].size()));
+	for (int i = 0; i < settings.ringSize; i++) {
+		frameRing.add(memories[i].data(), i);
+	}
+
+	TriggerSchedule triggerSchedule;
+	triggerSchedule.period = settings.period;
+	triggerSchedule.jitter = settings.jitter;
+	triggerSchedule.burstLength = settings.burstLength;
+	triggerSchedule.burstPause = settings.burstPause;
+
+	// Camera thread, numbers the frames like the uEye driver does
+	std::atomic<bool> cameraDone(false);
+	unsigned long long framesLost = 0;		// Frames the camera had nowhere to write
+	std::thread camera([&]() {
+		triggerSchedule.start(0);
+		for (int i = 0; i < settings.frames; i++) {
+			double wait = triggerSchedule.time(i) - triggerSchedule.now();
+			if (wait > 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(1000 * wait)));
+			}
+			RingFrame* frame = frameRing.nextWriteFrame();
+			if (frame == nullptr) {
+				framesLost++;
+				continue;
+			}
+			memcpy(frame->pMem, frames[i % frames.size()].data(), frames[0].size());
+			frameRing.frameWritten(frame, i);
+		}
+		cameraDone = true;
+	});
+
+	double timeTotal = 0;
+	while (true) {
+		bool done = cameraDone; // (Checked before waiting, so the last frame isn't missed)
+		RingFrame* frame = frameRing.waitForFrame(100);
+		if (frame == nullptr) {
+			if (done) break;
+			continue;
+		}
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		img.centroid(frame->pMem, pitch);
+		std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+		timeTotal += frameTime.count();
+		frameRing.release(frame);
+	}
+	camera.join();
+
+	unsigned long long processed = frameRing.processedCount();
+	printf("{\"method\": \"%s\", \"frames\": %d, \"spots\": %d, \"ring_size\": %d, \"period_ms\": %.2f, "
+		"\"jitter_ms\": %.2f, \"burst_length\": %d, \"burst_pause_ms\": %.2f, "
+		"\"threads\": %d, \"frames_processed\": %llu, \"frames_skipped\": %llu, \"frames_lost\": %llu, "
+		"\"mean_ms\": %.4f}\n",
+		useHybrid ? "hgcm" : "com", settings.frames, settings.spots, settings.ringSize, settings.period,
+		settings.jitter, settings.burstLength, settings.burstPause,
+		settings.threads, processed, frameRing.skippedCount(), framesLost,
+		processed ? timeTotal / processed : 0);
+	fflush(stdout);
+}
+
+// Centroid each frame once with one method, match the centroids to the true spot centers,
+// and print the results as a line of JSON
+// Only spots centered inside the AoI count, each spot can be found by at most one centroid
+void runAccuracy(BenchmarkSettings& settings, Centroid& img, std::vector<std::vector<char> >& frames,
+	std::vector<std::vector<SimulatedSpot> >& trueSpots, bool useHybrid)
+{
+	int pitch = (settings.bitDepth > 8) ? 2 * settings.width : settings.width;
+	img.setHybridMethod(useHybrid);
+
+	long long spotTotal = 0;		// True spots inside the AoI
+	long long centroidTotal = 0;	// Centroids found
+	long long matchedTotal = 0;		// Centroids matched to a true spot
+	double squaredErrorSum = 0;
+	double timeTotal = 0;
+	std::vector<bool> spotFound;
+	for (int f = 0; f < frames.size(); f++) {
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		img.centroid(frames[f].data(), pitch);
+		std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+		timeTotal += frameTime.count();
+
+		std::vector<SimulatedSpot>& spots = trueSpots[f];
+		spotFound.assign(spots.size(), false);
+		for (int s = 0; s < spots.size(); s++) {
+			bool inAoI = img.xLowerBound <= spots[s].X && spots[s].X < img.xUpperBound
+				&& img.yLowerBound <= spots[s].Y && spots[s].Y < img.yUpperBound;
+			if (inAoI) {
+				spotTotal++;
+			} else {
+				spotFound[s] = true; // (So nothing is matched to it)
+			}
+		}
+
+		// Match each centroid to the closest true spot not found yet
+		// (The hybrid method sends the CoM centroids of its small regions too, so both lists are matched)
+		int lastMethod = useHybrid ? 1 : 0;
+		for (int method = 0; method <= lastMethod; method++) {
+			int count = (method == 0) ? img.CCLCount : img.HybridCount;
+			centroidTotal += count;
+			for (int c = 0; c < count; c++) {
+				float X = img.Centroids(method, c, 0);
+				float Y = img.Centroids(method, c, 1);
+				int closest = -1;
+				float closestDistance = settings.matchRadius * settings.matchRadius;
+				for (int s = 0; s < spots.size(); s++) {
+					if (spotFound[s]) continue;
+					float distance = (spots[s].X - X) * (spots[s].X - X) + (spots[s].Y - Y) * (spots[s].Y - Y);
+					if (distance <= closestDistance) {
+						closest = s;
+						closestDistance = distance;
+					}
+				}
+				if (closest >= 0) {
+					spotFound[closest] = true;
+					matchedTotal++;
+					squaredErrorSum += closestDistance;
+				}
+			}
+		}
+	}
+
+	int frameCount = frames.size();
+	printf("{\"method\": \"%s\", \"frames\": %d, \"spots\": %d, \"aoi_width\": %d, \"aoi_height\": %d, "
+		"\"threshold\": %d, \"bit_depth\": %d, \"match_radius\": %.2f, \"true_spots_per_frame\": %.1f, "
+		"\"centroids_per_frame\": %.1f, \"detection_rate\": %.4f, \"false_positives_per_frame\": %.2f, "
+		"\"rms_error_px\": %.4f, \"ms_per_frame\": %.4f}\n",
+		useHybrid ? "hgcm" : "com", frameCount, settings.spots, settings.AoIWidth, settings.AoIHeight,
+		settings.threshold, settings.bitDepth, settings.matchRadius, spotTotal / (double)frameCount,
+		centroidTotal / (double)frameCount, spotTotal ? matchedTotal / (double)spotTotal : 0,
+		(centroidTotal - matchedTotal) / (double)frameCount,
+		matchedTotal ? sqrt(squaredErrorSum / matchedTotal) : 0, timeTotal / frameCount);
+	fflush(stdout);
+}
+
+// Print the frame rate of a simulator as a line of JSON
+void printSimulationSpeed(BenchmarkSettings& settings, const char* simulator, std::chrono::duration<double> runTime)
+{
+	printf("{\"simulator\": \"%s\", \"frames\": %d, \"spots\": %d, \"width\": %d, \"height\": %d, "
+		"\"fps\": %.1f, \"ms_per_frame\": %.4f}\n",
+		simulator, settings.frames, settings.spots, settings.width, settings.height,
+		settings.frames / runTime.count(), 1000 * runTime.count() / settings.frames);
+	fflush(stdout);
+}
+
+// Time making settings.frames images with each simulator
+void runSimulationSpeed(BenchmarkSettings& settings, Centroid& img)
+{
+	std::vector<char> simulatedImage(settings.width * settings.height);
+
+	ImageSimulator classic;
+	classic.baseNumberOfSpots = settings.spots;
+	classic.numberOfSpotsVariation = settings.spotVariation;
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for (int f = 0; f < settings.frames; f++) {
+		classic.simulateImage(simulatedImage, 7919 * f + 1, settings.width, settings.height, img);
+	}
+	printSimulationSpeed(settings, "classic", std::chrono::steady_clock::now() - runStart);
+
+	FastImageSimulator fast;
+	fast.baseNumberOfSpots = settings.spots;
+	fast.numberOfSpotsVariation = settings.spotVariation;
+	runStart = std::chrono::steady_clock::now();
+	for (int f = 0; f < settings.frames; f++) {
+		fast.simulateImage(simulatedImage, 7919 * f + 1, settings.width, settings.height, img);
+	}
+	printSimulationSpeed(settings, "fast", std::chrono::steady_clock::now() - runStart);
+
+	// (Frames are only taken and released, so this is how fast the background thread makes them)
+	PregeneratedFrames pregenerated;
+	runStart = std::chrono::steady_clock::now();
+	pregenerated.start(fast, 16, settings.width, settings.height, 1);
+	for (int f = 0; f < settings.frames; f++) {
+		if (pregenerated.take(1000) == nullptr) break;
+		pregenerated.release();
+	}
+	pregenerated.stop();
+	printSimulationSpeed(settings, "fast_pregenerated", std::chrono::steady_clock::now() - runStart);
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	if (!parseArguments(argc, argv, settings)) {
+		fprintf(stderr, "Unrecognized option, see the top of centroid_benchmark.cc for usage\n");
+		return 1;
+	}
+
+	// Set up centroiding the same way the camera does
+	Centroid img;
+	img.Image.assign(settings.width, settings.height);
+	img.RegionData.assign(2500);
+	img.threshold = settings.threshold;
+	img.UseRunLengthLabeling = settings.useRunLength;
+	img.setBitDepth(settings.bitDepth);
+	img.xLowerBound = (settings.width - settings.AoIWidth) / 2;
+	img.xUpperBound = img.xLowerBound + settings.AoIWidth;
+	img.yLowerBound = (settings.height - settings.AoIHeight) / 2;
+	img.yUpperBound = img.yLowerBound + settings.AoIHeight;
+	img.LEDxLowerBound = 5;
+	img.LEDxUpperBound = 25;
+	img.LEDyLowerBound = 5;
+	img.LEDyUpperBound = 25;
+	img.NoisexLowerBound = 30;
+	img.NoisexUpperBound = 50;
+	img.NoiseyLowerBound = 5;
+	img.NoiseyUpperBound = 25;
+
+	double mostAllocations = 0;	// Most allocations per frame of any timed run
+	for (int i = 0; i < settings.spotCounts.size(); i++) {
+		settings.spots = settings.spotCounts[i];
+
+		if (settings.simulationSpeed) {
+			runSimulationSpeed(settings, img);
+			continue;
+		}
+
+		// Simulate all frames before timing anything
+		ImageSimulator simulator;
+		simulator.baseNumberOfSpots = settings.spots;
+		simulator.numberOfSpotsVariation = settings.spotVariation;
+		FastImageSimulator fastSimulator;
+		fastSimulator.baseNumberOfSpots = settings.spots;
+		fastSimulator.numberOfSpotsVariation = settings.spotVariation;
+		int pixelCount = settings.width * settings.height;
+		int bytesPerPixel = (settings.bitDepth > 8) ? 2 : 1;
+		std::vector<char> simulatedImage(pixelCount);
+		std::vector<std::vector<char> > frames(settings.distinct);
+		std::vector<std::vector<SimulatedSpot> > trueSpots(settings.distinct);
+		for (int f = 0; f < settings.distinct; f++) {
+			if (settings.simulator == "fast") {
+				fastSimulator.simulateImage(simulatedImage, 7919 * f + 1, settings.width, settings.height, img);
+				trueSpots[f] = fastSimulator.spotCenters;
+			} else {
+				simulator.simulateImage(simulatedImage, 7919 * f + 1, settings.width, settings.height, img);
+				trueSpots[f] = simulator.spotCenters;
+			}
+			frames[f].resize(bytesPerPixel * pixelCount);
+			if (bytesPerPixel == 1) {
+				memcpy(frames[f].data(), simulatedImage.data(), pixelCount);
+			} else {
+				unsigned short* pixels = reinterpret_cast<unsigned short*>(frames[f].data());
+				for (int p = 0; p < pixelCount; p++) {
+					pixels[p] = (unsigned char)simulatedImage[p] << (settings.bitDepth - 8);
+				}
+			}
+		}
+
+		for (int t = 0; t < settings.threadCounts.size(); t++) {
+			settings.threads = settings.threadCounts[t];
+			img.setThreadCount(settings.threads);
+			if (settings.accuracy) {
+				if (settings.method != "hgcm") runAccuracy(settings, img, frames, trueSpots, false);
+				if (settings.method != "com") runAccuracy(settings, img, frames, trueSpots, true);
+			} else if (settings.ringSize > 0) {
+				if (settings.method != "hgcm") runRing(settings, img, frames, false);
+				if (settings.method != "com") runRing(settings, img, frames, true);
+			} else {
+				if (settings.method != "hgcm") mostAllocations = std::max(mostAllocations, runMethod(settings, img, frames, false));
+				if (settings.method != "com" && settings.gradient != "scalar") {
+					img.UseScalarGradient = false;
+					mostAllocations = std::max(mostAllocations, runMethod(settings, img, frames, true));
+				}
+				if (settings.method != "com" && settings.gradient != "sse2") {
+					img.UseScalarGradient = true;
+					mostAllocations = std::max(mostAllocations, runMethod(settings, img, frames, true));
+				}
+			}
+		}
+	}
+
+	if (settings.checkAllocations && mostAllocations > 0) {
+		fprintf(stderr, "Centroiding allocated %.3f times per frame once warmed up (should be 0)\n", mostAllocations);
+		return 1;
+	}
+	return 0;
+}
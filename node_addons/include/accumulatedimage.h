@@ -0,0 +1,41 @@
+#include <math.h>
+#include <stddef.h>
+
+/*
+
+Accumulated images count the electrons that landed on each pixel over many
+	frames, as binSize x binSize unsigned 32 bit counts (row by row)
+
+Centroids are scaled from AoI coordinates to the accumulated image and rounded
+	to the nearest pixel, the way ImageClasses.js always has, and centroids
+	that land outside the image are left out
+binIndex() does this for one centroid, so live images (accumulateCentroids(),
+	into a Uint32Array JS keeps) and recentroided recordings bin the same way
+
+*/
+
+// Pixel of an accumulated image a centroid at X, Y (AoI coordinates) lands on, or -1 if outside the image
+int binIndex(float X, float Y, int binSize, double AoIWidth, double AoIHeight)
+{
+	// (In double precision, like JS)
+	int binX = (int)floor((double)X * binSize / AoIWidth + 0.5);
+	int binY = (int)floor((double)Y * binSize / AoIHeight + 0.5);
+	if (binX < 0 || binX >= binSize || binY < 0 || binY >= binSize) return -1;
+	return binSize * binY + binX;
+}
+
+// Add count centroids (X, Y first, floatsPerCentroid values each) to image
+// Returns how many landed in the image
+unsigned int accumulateCentroids(unsigned int* image, int binSize, const float* centroids, int count, int floatsPerCentroid,
+	double AoIWidth, double AoIHeight)
+{
+	unsigned int binned = 0;
+	for (int i = 0; i < count; i++) {
+		const float* centroid = centroids + (size_t)i * floatsPerCentroid;
+		int index = binIndex(centroid[0], centroid[1], binSize, AoIWidth, AoIHeight);
+		if (index < 0) continue;
+		image[index]++;
+		binned++;
+	}
+	return binned;
+}
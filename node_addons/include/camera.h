@@ -10,6 +10,8 @@ public:
 	unsigned short ID;		// Camera ID
 	char model[32];			// Camera model number
 	int colorMode;			// Color mode of camera
+	int bitDepth = 8;		// Bits per pixel of images (8 is Mono8, 10/12/16 are stored in 2 bytes per pixel)
+	int frameBufferCount = 4;	// Number of image memories the camera writes frames into in turn
 
 	// non-OS specific variables used by camera (i.e. not Windows data types)
 	char* pMem; 			// Starting address of camera image memory
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <vector>
+
+/*
+
+CandidateMerger merges the zero-crossings that HGCM finds in a region into spot centers
+
+Two candidates belong to the same spot if they are less than MergeDistance apart
+	in both X and Y, and chains of such candidates are all one spot
+Each spot's center is the average of its candidates, weighted by the intensity
+	of each candidate's pixel, so the result doesn't depend on the order the
+	candidates were found in
+
+Candidates are put into a hash grid of MergeDistance sized cells, so only the
+	candidates in the 3x3 cells around each candidate have to be compared
+	and merging takes linear time however many candidates a region has
+Storage is reused from region to region, and only grows if a region has more
+	candidates than any region before
+
+*/
+
+const float MergeDistance = 1.5;
+
+// Zero-crossing candidate, or merged spot center
+struct Candidate
+{
+	float X;
+	float Y;
+	float weight;	// Intensity of the candidate's pixel (sum of intensities once merged)
+};
+
+class CandidateMerger
+{
+public:
+	std::vector<Candidate> candidates;	// Candidates of the current region
+	std::vector<Candidate> centers;		// Merged spot centers (first centerCount are valid)
+	int candidateCount = 0;
+	int centerCount = 0;
+
+	void clear();
+	void add(float X, float Y, float weight);
+	void merge();
+
+private:
+	// Cell of the hash grid, holding a linked list of the candidates in it
+	struct Cell
+	{
+		int cellX;
+		int cellY;
+		int first;	// First candidate in the cell (-1 if the cell is unused)
+	};
+	std::vector<Cell> cells;
+	std::vector<int> nextInCell;	// Next candidate in the same cell (-1 if last)
+	std::vector<int> parent;		// Union-find of candidates in the same spot
+	std::vector<int> centerOf;		// Spot center of each root candidate
+	std::vector<double> xSum;		// Weighted sums of each spot center
+	std::vector<double> ySum;
+	unsigned int cellMask = 0;
+
+	Cell& findCell(int cellX, int cellY);
+	int findRoot(int i);
+};
+
+// Start a new region
+void CandidateMerger::clear()
+{
+	candidateCount = 0;
+	centerCount = 0;
+}
+
+// Add a zero-crossing candidate
+void CandidateMerger::add(float X, float Y, float weight)
+{
+	if (candidateCount >= candidates.size()) {
+		candidates.resize(2 * candidates.size() + 16);
+	}
+	Candidate candidate = { X, Y, weight };
+	candidates[candidateCount++] = candidate;
+}
+
+// Cell (cellX, cellY) of the hash grid (linear probing, returns an unused cell if it isn't in the grid yet)
+CandidateMerger::Cell& CandidateMerger::findCell(int cellX, int cellY)
+{
+	unsigned int hash = ((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellY * 19349663u);
+	while (true) {
+		Cell& cell = cells[hash & cellMask];
+		if (cell.first == -1) {
+			cell.cellX = cellX;
+			cell.cellY = cellY;
+			return cell;
+		}
+		if (cell.cellX == cellX && cell.cellY == cellY) {
+			return cell;
+		}
+		hash++;
+	}
+}
+
+// Root candidate of candidate i's spot
+int CandidateMerger::findRoot(int i)
+{
+	// Path halving
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// Merge the candidates into spot centers
+void CandidateMerger::merge()
+{
+	centerCount = 0;
+	if (candidateCount == 0) return;
+
+	// Hash grid with at least twice as many cells as candidates (power of 2 so it can be masked)
+	unsigned int cellCount = 16;
+	while (cellCount < 2 * candidateCount) cellCount *= 2;
+	if (cells.size() < cellCount) {
+		cells.resize(cellCount);
+	}
+	Cell unused = { 0, 0, -1 };
+	for (unsigned int c = 0; c < cellCount; c++) {
+		cells[c] = unused;
+	}
+	if (parent.size() < candidates.size()) {
+		nextInCell.resize(candidates.size());
+		parent.resize(candidates.size());
+		centerOf.resize(candidates.size());
+		centers.resize(candidates.size());
+		xSum.resize(candidates.size());
+		ySum.resize(candidates.size());
+	}
+	cellMask = cellCount - 1;
+
+	// Join each candidate with the nearby candidates before it
+	for (int i = 0; i < candidateCount; i++) {
+		Candidate& candidate = candidates[i];
+		parent[i] = i;
+		int cellX = (int)floor(candidate.X / MergeDistance);
+		int cellY = (int)floor(candidate.Y / MergeDistance);
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int j = findCell(cellX + dx, cellY + dy).first; j != -1; j = nextInCell[j]) {
+					if (fabs(candidates[j].X - candidate.X) < MergeDistance && fabs(candidates[j].Y - candidate.Y) < MergeDistance) {
+						int iRoot = findRoot(i);
+						int jRoot = findRoot(j);
+						// Lower index becomes the root
+						if (iRoot < jRoot) parent[jRoot] = iRoot;
+						else parent[iRoot] = jRoot;
+					}
+				}
+			}
+		}
+		Cell& cell = findCell(cellX, cellY);
+		nextInCell[i] = cell.first;
+		cell.first = i;
+	}
+
+	// Weighted average of the candidates of each spot
+	// (the root of each spot is its first candidate, so it is seen before the rest)
+	for (int i = 0; i < candidateCount; i++) {
+		int root = findRoot(i);
+		if (root == i) {
+			centerOf[i] = centerCount;
+			Candidate empty = { 0, 0, 0 };
+			centers[centerCount] = empty;
+			xSum[centerCount] = 0;
+			ySum[centerCount] = 0;
+			centerCount++;
+		}
+		int c = centerOf[root];
+		centers[c].weight += candidates[i].weight;
+		xSum[c] += candidates[i].weight * (double)candidates[i].X;
+		ySum[c] += candidates[i].weight * (double)candidates[i].Y;
+	}
+	for (int c = 0; c < centerCount; c++) {
+		centers[c].X = xSum[c] / centers[c].weight;
+		centers[c].Y = ySum[c] / centers[c].weight;
+	}
+}
@@ -1,20 +1,93 @@
 #include <math.h>
 #include <vector>
+#include <algorithm>
 #include "CImg.h"
 #include "timer.h"
+#include "regiontable.h"
+#include "prescan.h"
+#include "gradient.h"
+#include "candidatemerge.h"
+#include "threadpool.h"
 
 #include <stdio.h>
 
 using namespace cimg_library;
 
+// Horizontal run of neighboring lit pixels in one row
+// (Every lit pixel is part of a run, all pixels of a run are in the same region)
+struct PixelRun
+{
+	int Y;					// Row of the run
+	int xStart;				// First pixel of the run
+	int xEnd;				// One past the last pixel of the run
+	unsigned int label;		// Region label of the run (0 if not labeled)
+	unsigned long long xSum;	// Sum of X * pixel intensity
+	unsigned int intensity;		// Sum of pixel intensities
+};
+
+// Read-only view of an image in camera memory (rows are pitch bytes apart)
+// Lets the image be centroided right where the camera put it, without copying it
+// Pixels are read as unsigned char (Mono8) or unsigned short (Mono10/12/16)
+struct PixelView
+{
+	const char* pixels = nullptr;			// First byte of the image
+	int pitch = 0;							// Bytes from the start of one row to the next
+	int imageWidth = 0;
+	int imageHeight = 0;
+
+	// Set the image size (no memory is allocated)
+	void assign(int Width, int Height)
+	{
+		imageWidth = Width;
+		imageHeight = Height;
+	}
+
+	// Point the view at a new image (memory must stay valid until centroiding is done)
+	void attach(char* pMem, int pPitch)
+	{
+		pixels = pMem;
+		pitch = pPitch;
+	}
+
+	int width() { return imageWidth; }
+	int height() { return imageHeight; }
+
+	// First pixel of row Y
+	template <typename Pixel>
+	const Pixel* row(int Y) { return reinterpret_cast<const Pixel*>(pixels + Y * pitch); }
+};
+
+// Horizontal strip of the image, labeled by one thread
+// Each strip hands out labels from its own range so strips never share a label
+struct ImageStrip
+{
+	int yStart;					// First row of the strip
+	int yEnd;					// One past the last row of the strip
+	unsigned int firstLabel;	// First label the strip can hand out
+	unsigned int lastLabel;		// Last label the strip can hand out
+	unsigned int nextLabel;		// Next label to hand out
+	bool overflowed;			// Whether the strip ran out of labels
+
+	std::vector<PixelRun> Runs;	// Runs of lit pixels in the strip, in row order
+	std::vector<int> LitBlocks;	// Start of each block of a row with a pixel above threshold
+	std::vector<unsigned int> RowLabels[2];	// Labels of each pixel of the current and previous row
+											// (Row Y is in RowLabels[Y % 2], only used for pixel labeling)
+
+	int LEDIntensity;			// Total pixel intensity of LED area within strip
+	float LEDCount;				// Number of pixels in LED area within strip
+	int NoiseIntensity;			// Total pixel intensity of Noise area within strip
+	float NoiseCount;			// Number of pixels in Noise area within strip
+};
+
 /* ---------- Class for Individual Image Simulation + Centroiding ---------- */
 class Centroid
 {
 public:
-	int CCLCount;
-	int HybridCount;			 // Count of centroided electrons
+	int CCLCount = 0;
+	int HybridCount = 0;		 // Count of centroided electrons
 	unsigned int regions;		 // Number of different regions found
 	unsigned int threshold = 20; // Lower limit of image signal / upper limit of image noise
+								 // (in 8-bit units, scaled up to the bit depth of the camera)
 	int minPix = 3;				 // Lower region bound to calculate center for
 	int maxPix = 120;			 // Upper region bound to use CoM method
 
@@ -41,67 +114,117 @@ public:
 	float NoiseCount = 0;		// Number of pixels in Noise area
 	bool isLEDon = false; 		// Whether LED is on, indicating IR laser fired this image
 
-	bool UseHybridMethod = true;		// Whether to use hybrid method
+	bool UseHybridMethod = true;		// Whether to use hybrid method (set with setHybridMethod())
+	int BitDepth = 8;					// Bits per pixel of camera images (set with setBitDepth())
+	bool UseRunLengthLabeling = false;	// Whether to label runs of lit pixels instead of single pixels
+	bool UseScalarGradient = false;		// Whether HGCM uses the scalar zero-crossing test even with SSE2 (to compare the two)
+
+	PixelView Image;				 // Image to centroid (camera memory)
+	RegionTable RegionData;			 // Equivalences and Center of Mass parameters of each region label
+	std::vector<PixelRun> LargeRegionRuns; // Runs of each region with at least maxPix pixels, grouped by region
 
-	CImg<unsigned int> Image;		 // Image to centroid
-	CImg<unsigned int> RegionImage;	 // Image of pixel regions
-	CImg<unsigned int> RegionVector; // Vector pointing to parent regions
-	CImg<unsigned int> COMs;		 // Center of Mass parameters
+	ThreadPool Workers;				 // Threads used to label strips of the image in parallel
+	std::vector<ImageStrip> Strips;	 // One strip of the image per thread
 
 	CImgList<float> Centroids; // List of CCL Centroids and Hybrid Centroids
+							   // (Reused each image, only the first CCLCount/HybridCount are valid)
+	CandidateMerger HybridCandidates; // Zero-crossings found in a region by HGCM (reused for each region)
 
 	float computationTime; // Time it took to calculate centroids
+	float hgcmTime = 0;		// Part of it spent by HGCM on the large regions (0 for the CoM method)
+
+	// Centroiding function for the current pixel type and method
+	// (Picked by selectCentroidFunction() whenever those settings change, rather than checked every image)
+	void (Centroid::*centroidFunction)(char* pMem, int pPitch);
 
 	// Functions
 	Centroid();
 	Centroid(int Width, int Height);
-	void findRegions(std::vector<unsigned char>& Buffer, char* pMem, int pPitch);
-	int getRegion(int X, int Y);
-	int getParent(int Region);
-	void reduceRegionCOMs();
-	void reduceRegionImage();
-	void CoMMethod(std::vector<unsigned char>& Buffer, char* pMem, int pPitch);
-	void HGCMMethod(std::vector<unsigned char>& Buffer, char* pMem, int pPitch);
-	void centroid(std::vector<unsigned char>& Buffer, char* pMem, int pPitch);
-	void updateBuffer(std::vector<unsigned char>& Buffer, int X, int Y, int imageWidth, unsigned char pixValue);
+	void setThreadCount(int count);
+	void setHybridMethod(bool useHybrid);
+	void setBitDepth(int bits);
+	void selectCentroidFunction();
+	template <typename Pixel> void findRegions(char* pMem, int pPitch);
+	template <typename Pixel> static void findRegionsInStrip(void* centroid, int stripIndex);
+	template <typename Pixel> void findRegionsInStrip(ImageStrip& strip);
+	void joinStrips(ImageStrip& above, ImageStrip& below);
+	void labelPixel(ImageStrip& strip, int X, int Y, unsigned int pixValue);
+	int getRegion(ImageStrip& strip, int X, int Y);
+	unsigned int newLabel(ImageStrip& strip);
+	void addToRun(ImageStrip& strip, int X, int Y, unsigned int pixValue);
+	void labelRuns(ImageStrip& strip, int previousRow, int currentRow);
+	void reduceRegions();
+	void groupLargeRegionRuns();
+	void addCentroid(int method, int& count, float X, float Y, float intensity);
+	template <typename Pixel> void CoMMethod(char* pMem, int pPitch);
+	template <typename Pixel> void HGCMMethod(char* pMem, int pPitch);
+	template <typename Pixel, bool Hybrid> void centroidImage(char* pMem, int pPitch);
+	void centroid(char* pMem, int pPitch);
 };
 
 // Initialize class
 Centroid::Centroid()
 {
-	Centroids.assign(2);
+	Centroids.assign(2, 2500, 3); // (xCenter, yCenter, avgPixIntensity)
+	selectCentroidFunction();
 }
 
 // Initialize class with specified image size
 Centroid::Centroid(int Width, int Height)
 {
 	Image.assign(Width, Height);
-	Centroids.assign(2);
+	Centroids.assign(2, 2500, 3); // (xCenter, yCenter, avgPixIntensity)
+	selectCentroidFunction();
 }
 
-// Analyze image to find regions of neighboring lit pixels
-void Centroid::findRegions(std::vector<unsigned char>& Buffer, char* pMem, int pPitch)
+// Set the number of threads used to find regions
+// (The image is split into one horizontal strip per thread)
+void Centroid::setThreadCount(int count)
 {
-	// Image parameters
-	int Width = Image.width();
-	int Height = Image.height();
+	Workers.setThreadCount(count);
+}
 
-	// Create the necessary centroiding arrays
-	//COMs.assign(1500, 4);
-	COMs.fill(0); // Center of Mass parameters
+// Set whether to use the hybrid (HGCM) method or just CoM
+void Centroid::setHybridMethod(bool useHybrid)
+{
+	UseHybridMethod = useHybrid;
+	selectCentroidFunction();
+}
 
-	//RegionImage.assign(Width, Height);
-	RegionImage.fill(0); // Image of each pixel's region number
+// Set the bits per pixel of camera images
+// 8 bits are read as Mono8 (1 byte per pixel), 9 to 16 bits as Mono10/12/16 (2 bytes per pixel)
+void Centroid::setBitDepth(int bits)
+{
+	if (bits < 8) bits = 8;
+	if (bits > 16) bits = 16;
+	BitDepth = bits;
+	selectCentroidFunction();
+}
 
-	//RegionVector.assign(1500, 3); 	// Vector to keep track of region connectivity
-	RegionVector.fill(0); 			// 1st element is the region that the i'th region points to
-									// 2nd element is the region that points to the i'th region
-									// 3rd element is the parent region (i.e. points to no region)
-	// If two regions are equivalent, the region with the larger parent is appended to the end 
-	// of the chain of the region with the smaller parent
+// Pick the version of the centroiding functions made for the current pixel type and method
+void Centroid::selectCentroidFunction()
+{
+	if (BitDepth <= 8) {
+		if (UseHybridMethod) centroidFunction = &Centroid::centroidImage<unsigned char, true>;
+		else centroidFunction = &Centroid::centroidImage<unsigned char, false>;
+	} else {
+		if (UseHybridMethod) centroidFunction = &Centroid::centroidImage<unsigned short, true>;
+		else centroidFunction = &Centroid::centroidImage<unsigned short, false>;
+	}
+}
+
+// Analyze image to find regions of neighboring lit pixels
+template <typename Pixel>
+void Centroid::findRegions(char* pMem, int pPitch)
+{
+	// Look at the image right where it is in camera memory
+	Image.attach(pMem, pPitch);
+
+	// Image parameters
+	int Height = Image.height();
 
 	// Reset regions counter
-	regions = 1;
+	regions = 0;
 
 	// Reset LED and Noise Intensity sums
 	LEDIntensity = 0;
@@ -112,190 +235,400 @@ void Centroid::findRegions(std::vector<unsigned char>& Buffer, char* pMem, int p
 
 	//printf("centroid2 - findRegions() - everything initialized \n");
 
-	// Go through each pixel and add it to a region if sufficient intensity
-	int regionNo;
-	for (int Y = 1; Y < Height - 1; Y++)
+	// Split the rows that can be centroided (all but the outermost) into one strip per thread
+	// and split the label table evenly between strips
+	int stripCount = Workers.threadCount();
+	if (stripCount > Height - 2) stripCount = 1;
+	if (Strips.size() != stripCount) Strips.resize(stripCount);
+	// Make sure every strip has room for at least one label
+	while (RegionData.size() <= stripCount) {
+		RegionData.grow();
+	}
+
+	// If any strip runs out of labels, the region table is grown and the image is labeled again
+	// (rare, and much better than silently losing electrons)
+	bool overflowed = true;
+	while (overflowed)
 	{
-		//printf("centroid2 - findRegions() - row %d \n", Y);
-		for (int X = 1; X < Width - 1; X++)
+		unsigned int labelsPerStrip = (RegionData.size() - 1) / stripCount;
+		for (int i = 0; i < stripCount; i++)
 		{
-			unsigned char pixValue = *(reinterpret_cast<char*>(pMem + X + Y*pPitch));
-			Image(X, Y) = pixValue;
+			ImageStrip& strip = Strips[i];
+			strip.yStart = 1 + i * (Height - 2) / stripCount;
+			strip.yEnd = 1 + (i + 1) * (Height - 2) / stripCount;
+			strip.firstLabel = 1 + i * labelsPerStrip;
+			strip.lastLabel = strip.firstLabel + labelsPerStrip - 1;
+		}
 
-			updateBuffer(Buffer, X, Y, Width, pixValue);
+		// Label each strip (in parallel if using more than one thread)
+		Workers.run(stripCount, findRegionsInStrip<Pixel>, this);
 
-			// Make sure we don't run out of memory
-			if (regions >= RegionVector.width()) continue;
-			//printf("centroid2 - findRegions() - col %d - regions: %d \n", X, regions);
+		overflowed = false;
+		for (int i = 0; i < stripCount; i++) {
+			overflowed = overflowed || Strips[i].overflowed;
+		}
+		if (overflowed) {
+			RegionData.grow();
+		}
+	}
+
+	// Combine strips
+	for (int i = 0; i < stripCount; i++)
+	{
+		ImageStrip& strip = Strips[i];
+		LEDIntensity += strip.LEDIntensity;
+		LEDCount += strip.LEDCount;
+		NoiseIntensity += strip.NoiseIntensity;
+		NoiseCount += strip.NoiseCount;
+
+		// Regions touching across the seam between strips are the same region
+		if (i > 0) {
+			joinStrips(Strips[i - 1], strip);
+		}
+
+		// Labels a strip didn't use need to be valid (empty) regions as well,
+		// so that every label up to the last one used can be reduced
+		if (i < stripCount - 1) {
+			for (unsigned int label = strip.nextLabel; label <= strip.lastLabel; label++) {
+				RegionData.makeSet(label);
+			}
+		}
+	}
+	regions = Strips[stripCount - 1].nextLabel - 1;
+}
+
+// Find regions in one strip of the image
+// (Thread pool entry point, centroid is the Centroid object)
+template <typename Pixel>
+void Centroid::findRegionsInStrip(void* centroid, int stripIndex)
+{
+	Centroid* self = static_cast<Centroid*>(centroid);
+	self->findRegionsInStrip<Pixel>(self->Strips[stripIndex]);
+}
+
+// Find regions in one strip of the image
+// Only touches the strip's rows of each image and the strip's labels,
+// so different strips can be labeled at the same time
+template <typename Pixel>
+void Centroid::findRegionsInStrip(ImageStrip& strip)
+{
+	// Image parameters
+	int Width = Image.width();
+
+	strip.nextLabel = strip.firstLabel;	// Labels (and their equivalences) from the last image are forgotten
+	strip.overflowed = false;
+	strip.Runs.clear();					// Runs of lit pixels from the last image (memory is kept)
+
+	strip.LEDIntensity = 0;
+	strip.LEDCount = 0;
+	strip.NoiseIntensity = 0;
+	strip.NoiseCount = 0;
+
+	// Part of each row inside the centroiding AoI (the outermost pixels are never centroided)
+	int xStart = xLowerBound;
+	if (xStart < 1) xStart = 1;
+	int xEnd = xUpperBound;
+	if (xEnd > Width - 1) xEnd = Width - 1;
+	// Threshold as a pixel value (a threshold above the largest pixel value means no pixel can be lit)
+	// (threshold is in 8-bit units, so it's shifted up to the camera's bit depth)
+	int displayShift = BitDepth - 8;
+	unsigned int maxPixel = (sizeof(Pixel) == 1) ? 0xFF : 0xFFFF;
+	unsigned int scaledThreshold = threshold << displayShift;
+	bool canBeLit = (scaledThreshold <= maxPixel);
+	Pixel pixThreshold = canBeLit ? scaledThreshold : maxPixel;
+	// Make sure there is room for every block of a row
+	if (strip.LitBlocks.size() < Width / PrescanBlockSize + 1) {
+		strip.LitBlocks.resize(Width / PrescanBlockSize + 1);
+	}
+	// Nothing is lit before the first row of the strip
+	// (The row above the strip belongs to a different strip, so it's ignored here)
+	if (!UseRunLengthLabeling) {
+		strip.RowLabels[0].assign(Width, 0);
+		strip.RowLabels[1].assign(Width, 0);
+	}
 
-			// Check if pixel is within Noise of LED areas
-			if ((LEDyLowerBound <= Y && Y < LEDyUpperBound) && (LEDxLowerBound <= X && X < LEDxUpperBound)) {
-				LEDIntensity += (int)pixValue;
-				LEDCount++;
+	// Go through each row, then add each lit pixel to a region
+	int rowBeforeLast = 0; 	// Index of the first run two rows back
+	int previousRow = 0; 	// Index of the first run in the previous row
+	for (int Y = strip.yStart; Y < strip.yEnd; Y++)
+	{
+		//printf("centroid2 - findRegions() - row %d \n", Y);
+		const Pixel* row = Image.row<Pixel>(Y);
+
+		// Check if row is within Noise or LED areas
+		// (Pixels in both areas only count towards the LED area)
+		bool inLEDRows = (LEDyLowerBound <= Y && Y < LEDyUpperBound);
+		if (inLEDRows) {
+			for (int X = LEDxLowerBound; X < LEDxUpperBound; X++) {
+				if (X < 1 || X >= Width - 1) continue;
+				strip.LEDIntensity += (int)row[X];
+				strip.LEDCount++;
 			}
-			else if ((NoiseyLowerBound <= Y && Y < NoiseyUpperBound) && (NoisexLowerBound <= X && X < NoisexUpperBound)) {
-				NoiseIntensity += (int)pixValue;
-				NoiseCount++;
+		}
+		if (NoiseyLowerBound <= Y && Y < NoiseyUpperBound) {
+			for (int X = NoisexLowerBound; X < NoisexUpperBound; X++) {
+				if (X < 1 || X >= Width - 1) continue;
+				if (inLEDRows && LEDxLowerBound <= X && X < LEDxUpperBound) continue;
+				strip.NoiseIntensity += (int)row[X];
+				strip.NoiseCount++;
 			}
+		}
+
+		// Check if row is within centroiding AoI
+		if (!canBeLit || Y < yLowerBound || Y >= yUpperBound || xStart >= xEnd) continue;
 
-			// Check if pixel is within centroiding AoI
-			if ((yLowerBound <= Y && Y < yUpperBound) && (xLowerBound <= X && X < xUpperBound)) {
+		// Only look at the blocks of the row that have at least one pixel above threshold
+		int currentRow = strip.Runs.size(); // Index of the first run in this row
+		if (!UseRunLengthLabeling) {
+			// This row's labels reuse the labels of two rows back, which only need to be cleared where lit
+			unsigned int* currentLabels = strip.RowLabels[Y % 2].data();
+			for (int r = rowBeforeLast; r < previousRow; r++) {
+				std::fill(currentLabels + strip.Runs[r].xStart, currentLabels + strip.Runs[r].xEnd, 0);
+			}
+		}
+		int litBlockCount = findLitBlocks(row + xStart, xEnd - xStart, pixThreshold, strip.LitBlocks.data());
+		for (int block = 0; block < litBlockCount; block++)
+		{
+			int blockStart = xStart + strip.LitBlocks[block];
+			int blockEnd = blockStart + PrescanBlockSize;
+			if (blockEnd > xEnd) blockEnd = xEnd;
+			for (int X = blockStart; X < blockEnd; X++)
+			{
 				// Make sure intensity is above noise threshold
-				if (pixValue >= threshold)
+				if (row[X] >= pixThreshold)
 				{
-					regionNo = getRegion(X, Y);
-					RegionImage(X, Y) = regionNo;
-					//printf("centroid2 - findRegions() - regionNo %d \n", regionNo);
-
-					COMs(regionNo, 0) += X * pixValue;
-					COMs(regionNo, 1) += Y * pixValue;
-					COMs(regionNo, 2) += pixValue;
-					COMs(regionNo, 3)++;
+					labelPixel(strip, X, Y, row[X]);
 				}
 			}
 		}
+
+		// Runs are labeled once the whole row has been read
+		if (UseRunLengthLabeling) {
+			labelRuns(strip, previousRow, currentRow);
+		}
+		rowBeforeLast = previousRow;
+		previousRow = currentRow;
+	}
+}
+
+// Join regions that touch across the seam between two neighboring strips
+void Centroid::joinStrips(ImageStrip& above, ImageStrip& below)
+{
+	int seam = below.yStart; // First row of the lower strip
+
+	// Runs of the last row of the upper strip are at the end of its list,
+	// runs of the first row of the lower strip are at the start of its list
+	int p = above.Runs.size();
+	while (p > 0 && above.Runs[p - 1].Y == seam - 1) p--;
+	int c = 0;
+	while (p < above.Runs.size() && c < below.Runs.size() && below.Runs[c].Y == seam)
+	{
+		PixelRun& upper = above.Runs[p];
+		PixelRun& lower = below.Runs[c];
+		if (upper.xStart < lower.xEnd && lower.xStart < upper.xEnd && upper.label != 0 && lower.label != 0) {
+			RegionData.unite(upper.label, lower.label);
+		}
+		// Move on from whichever run ends first
+		if (upper.xEnd < lower.xEnd) p++;
+		else c++;
 	}
 }
 
+// Add lit pixel (X,Y) to a region
+void Centroid::labelPixel(ImageStrip& strip, int X, int Y, unsigned int pixValue)
+{
+	if (UseRunLengthLabeling) {
+		addToRun(strip, X, Y, pixValue);
+		return;
+	}
+
+	int regionNo = getRegion(strip, X, Y);
+	// Make sure we don't run out of memory
+	if (regionNo == 0) return;
+	strip.RowLabels[Y % 2][X] = regionNo;
+	//printf("centroid2 - findRegions() - regionNo %d \n", regionNo);
+
+	// Keep track of the runs of each region (needed by HGCM)
+	addToRun(strip, X, Y, pixValue);
+	strip.Runs.back().label = regionNo;
+
+	Region& region = RegionData[regionNo];
+	region.xSum += X * pixValue;
+	region.ySum += Y * pixValue;
+	region.intensity += pixValue;
+	region.pixelCount++;
+	RegionData.extendBox(region, X, X, Y);
+}
+
 // Get the region number of pixel (X,Y)
-int Centroid::getRegion(int X, int Y)
+// Returns 0 if the strip ran out of labels
+int Centroid::getRegion(ImageStrip& strip, int X, int Y)
 {
 	// A is the left pixel, B is the above pixel
 	// If the region value is 0, the corresponding pixel was not lit
-	int A = RegionImage(X - 1, Y);
-	int B = RegionImage(X, Y - 1);
+	int A = strip.RowLabels[Y % 2][X - 1];
+	int B = strip.RowLabels[(Y + 1) % 2][X];
 
-	// Find A,B's current parent region values
-	int aParent = getParent(A);
-	int bParent = getParent(B);
+	if (A == 0 && B == 0) // Both neighbors are unlit
+	{
+		return newLabel(strip);
+	}
+	if (B == 0) // Only left neighbor is lit
+	{
+		return A;
+	}
+	if (A == 0 || A == B) // Only above neighbor is lit, or both are already in same region
+	{
+		return B;
+	}
+	// Pixel connects two different regions, mark them as equivalent
+	RegionData.unite(A, B);
+	return A;
+}
 
-	//printf("A: %d, B: %d, aParent: %d, bParent: %d \n", A, B, aParent, bParent);
+// Hand out the strip's next label
+// Returns 0 if the strip ran out of labels
+unsigned int Centroid::newLabel(ImageStrip& strip)
+{
+	if (strip.nextLabel > strip.lastLabel) {
+		strip.overflowed = true;
+		return 0;
+	}
+	unsigned int label = strip.nextLabel++;
+	RegionData.makeSet(label);
+	return label;
+}
 
-	int returnValue;
-	
-	if (A == B)
+// Add lit pixel (X,Y) to the current run, or start a new run
+void Centroid::addToRun(ImageStrip& strip, int X, int Y, unsigned int pixValue)
+{
+	std::vector<PixelRun>& Runs = strip.Runs;
+	if (!Runs.empty() && Runs.back().Y == Y && Runs.back().xEnd == X)
 	{
-		if (A == 0) // Both neighbors are unlit
-		{ 
-			regions++;
-			returnValue = regions;
-		}
-		else // A and B are the same region
-		{ 
-			// Assign pixel to A's parent region
-			returnValue = aParent;
-		}
+		// Pixel continues the last run
+		PixelRun& run = Runs.back();
+		run.xEnd++;
+		run.xSum += (unsigned long long)X * pixValue;
+		run.intensity += pixValue;
 	}
-	else if (aParent == bParent) // Both regions have same parent
+	else
 	{
-		// Assign pixel to A's parent region
-		returnValue = aParent;
-	}
-	else if (aParent < bParent) // Add B's chain to end of A's chain
-	{ 
-		// First need to find end of A's chain
-		int aEnd = RegionVector(A, 1);
-		if (aEnd == 0) // A is the end
-		{
-			// Point bParent to A
-			RegionVector(bParent, 0) = A;
-		}
-		else // Need to find the end
-		{
-			while (RegionVector(aEnd, 1) != 0) {
-				aEnd = RegionVector(aEnd, 1);
-			}
-			// Point bParent to aEnd
-			RegionVector(bParent, 0) = aEnd;
-		}
-		// Now make sure all of B's chain points to A's parent
-		returnValue = getParent(bParent);
+		PixelRun run = { Y, X, X + 1, 0, (unsigned long long)X * pixValue, pixValue };
+		Runs.push_back(run);
 	}
-	else // Add A's chain to end of B's chain
+}
+
+// Label the runs of the current row by the overlapping runs of the previous row
+// Runs from previousRow up to currentRow are the previous row, the rest are the current row
+void Centroid::labelRuns(ImageStrip& strip, int previousRow, int currentRow)
+{
+	std::vector<PixelRun>& Runs = strip.Runs;
+	int p = previousRow; // First previous row run that could overlap the current run
+	for (int c = currentRow; c < Runs.size(); c++)
 	{
-		// First need to find end of B's chain
-		int bEnd = RegionVector(B, 1);
-		if (bEnd == 0) // B is the end
-		{
-			// Point aParent to B
-			RegionVector(aParent, 0) = B;
+		PixelRun& run = Runs[c];
+
+		// Skip previous row runs that end before this run starts
+		while (p < currentRow && Runs[p].xEnd <= run.xStart) {
+			p++;
 		}
-		else // Need to find the end
+		// Every previous row run that overlaps this run is in the same region
+		// (p isn't advanced here since the last of these can overlap the next run too)
+		for (int q = p; q < currentRow && Runs[q].xStart < run.xEnd; q++)
 		{
-			while (RegionVector(bEnd, 1) != 0) {
-				bEnd = RegionVector(bEnd, 1);
+			if (Runs[q].label == 0) continue; // Run was not labeled
+			if (run.label == 0) {
+				run.label = Runs[q].label;
+			} else if (run.label != Runs[q].label) {
+				RegionData.unite(run.label, Runs[q].label);
 			}
-			// Point aParent to bEnd
-			RegionVector(aParent, 0) = bEnd;
 		}
-		// Now make sure all of A's chain points to B's parent
-		returnValue = getParent(aParent);
-	}
-	return returnValue;
-}
 
-// Make sure the listed parent region is correct
-// Otherwise update RegionVector
-int Centroid::getParent(int Region) {
-	int Parent;
-	if (RegionVector(Region, 0) != 0) {
-		// This region points to another region, can't be a parent
-		// Work forward to find parent
-		Parent = RegionVector(Region, 0);
-		while (RegionVector(Parent, 0) != 0) {
-			Parent = RegionVector(Parent, 0);
-		}
-		// Now we have the parent. Work backwards and update equivalent regions
-		int thisRegion = Parent;
-		while (RegionVector(thisRegion, 1) != 0) {
-			RegionVector(thisRegion, 2) = Parent;
-			thisRegion = RegionVector(thisRegion, 1);
+		if (run.label == 0)
+		{
+			run.label = newLabel(strip);
+			// Make sure we don't run out of memory
+			if (run.label == 0) continue;
 		}
-		RegionVector(thisRegion, 2) = Parent; // Make sure the last region's parent is updated
-		// Now the parents of all equivalent regions should be updated
-	} else {
-		// This region is the parent
-		Parent = Region;
-	}
 
-	return Parent;
+		Region& region = RegionData[run.label];
+		region.xSum += run.xSum;
+		region.ySum += (unsigned long long)run.Y * run.intensity;
+		region.intensity += run.intensity;
+		region.pixelCount += run.xEnd - run.xStart;
+		RegionData.extendBox(region, run.xStart, run.xEnd - 1, run.Y);
+	}
 }
 
-// Reduce Region CoM values to only parent regions
+// Merge each region's CoM values into its parent region
 // (child regions will have 0 for all stored values)
-void Centroid::reduceRegionCOMs() 
+// Afterwards, RegionData[label].parent is the parent region of any label
+void Centroid::reduceRegions()
 {
-	for (int i = regions; i > 0; i--) // Go through RegionVector in reverse
+	RegionData.flatten(regions);
+	for (int i = 1; i <= regions; i++)
 	{
-		if (RegionVector(i, 0) != 0) // Not a parent region
-		{ 
-			int parentRegion = RegionVector(i, 2);
-			if (parentRegion == 0 || RegionVector(parentRegion, 0) != 0) // Actual parent not stored
-			{
-				parentRegion = getParent(i);
-			}
+		int parentRegion = RegionData[i].parent;
+		if (parentRegion != i) // Not a parent region
+		{
 			// Add values to parent region
-			for (int k = 0; k < 4; k++)
-			{ 
-				COMs(parentRegion, k) += COMs(i, k);
-				// Set child values to zero
-				COMs(i, k) = 0;
-			}
+			Region& child = RegionData[i];
+			Region& parent = RegionData[parentRegion];
+			parent.xSum += child.xSum;
+			parent.ySum += child.ySum;
+			parent.intensity += child.intensity;
+			parent.pixelCount += child.pixelCount;
+			RegionData.mergeBox(parent, child);
+			// Set child values to zero
+			child.xSum = 0;
+			child.ySum = 0;
+			child.intensity = 0;
+			child.pixelCount = 0;
 		}
 	}
 }
 
-// Reduce Region Image to only parent regions
-void Centroid::reduceRegionImage()
+// Group the runs of every region with at least maxPix pixels by region (must be done after reduceRegions())
+// Runs of each region stay in row order, and RegionData[region].firstRun/runCount say where they are
+void Centroid::groupLargeRegionRuns()
 {
-	// Must be done after centroid()
-	for (int Y = 0; Y < Image.height(); Y++)
-	{
-		for (int X = 0; X < Image.width(); X++)
-		{
-			if (RegionImage(X, Y) != 0)
-			{
-				RegionImage(X, Y) = RegionVector(RegionImage(X, Y), 2);
+	// Count the runs of each large region
+	int runTotal = 0;
+	for (int i = 0; i < Strips.size(); i++) {
+		std::vector<PixelRun>& Runs = Strips[i].Runs;
+		for (int r = 0; r < Runs.size(); r++) {
+			if (Runs[r].label == 0) continue;
+			Region& region = RegionData[RegionData[Runs[r].label].parent];
+			if (region.pixelCount >= maxPix) {
+				region.runCount++;
+				runTotal++;
+			}
+		}
+	}
+
+	// Give each large region its own part of the list
+	// (Leave room to spare so that the list isn't reallocated every time a frame has a few more runs)
+	if (LargeRegionRuns.size() < runTotal) {
+		LargeRegionRuns.resize(2 * runTotal);
+	}
+	unsigned int nextRun = 0;
+	for (int i = 1; i <= regions; i++) {
+		Region& region = RegionData[i];
+		if (region.runCount == 0) continue;
+		region.firstRun = nextRun;
+		nextRun += region.runCount;
+		region.runCount = 0;
+	}
+
+	// Fill in the list
+	for (int i = 0; i < Strips.size(); i++) {
+		std::vector<PixelRun>& Runs = Strips[i].Runs;
+		for (int r = 0; r < Runs.size(); r++) {
+			if (Runs[r].label == 0) continue;
+			Region& region = RegionData[RegionData[Runs[r].label].parent];
+			if (region.pixelCount >= maxPix) {
+				LargeRegionRuns[region.firstRun + region.runCount] = Runs[r];
+				region.runCount++;
 			}
 		}
 	}
@@ -303,30 +636,46 @@ void Centroid::reduceRegionImage()
 
 // ----- List of Centroiding Methods ----- //
 
+// Add a centroid to the end of a method's list (method 0 is CoM, 1 is HGCM)
+// The list only grows (keeping its contents) if it is full, otherwise no memory is allocated
+void Centroid::addCentroid(int method, int& count, float X, float Y, float intensity)
+{
+	CImg<float>& centers = Centroids[method];
+	if (count >= centers.width())
+	{
+		CImg<float> grown(2 * centers.width() + 1, 3);
+		for (int c = 0; c < count; c++) {
+			grown(c, 0) = centers(c, 0);
+			grown(c, 1) = centers(c, 1);
+			grown(c, 2) = centers(c, 2);
+		}
+		Centroids[method] = grown;
+	}
+	Centroids(method, count, 0) = X;
+	Centroids(method, count, 1) = Y;
+	Centroids(method, count, 2) = intensity;
+	count++;
+}
+
 // Find Center-of-Mass(Gravity) of each region in image
-void Centroid::CoMMethod(std::vector<unsigned char>& Buffer, char* pMem, int pPitch) {
-	CImg<float> CCLCenters(2500, 3); // (xCenter, yCenter, avgPixIntensity)
-	CCLCenters.fill(0);
-	int centroidCount = 0; // Keep track of number of centroids found
+template <typename Pixel>
+void Centroid::CoMMethod(char* pMem, int pPitch) {
+	CCLCount = 0; // Keep track of number of centroids found
 
 	// First find the regions in the image
-	findRegions(Buffer, pMem, pPitch);
+	findRegions<Pixel>(pMem, pPitch);
 	//printf("centroid2 - CoMMethod() - regions found \n");
-	reduceRegionCOMs();
-	//printf("centroid2 - CoMMethod() - regions CoM reduced \n");
-	reduceRegionImage();
-	//printf("centroid2 - CoMMethod() - regions Image reduced \n");
+	reduceRegions();
+	//printf("centroid2 - CoMMethod() - regions reduced \n");
 
 	// For each region, find the center of mass
-	for (int i = 0; i < regions; i++)
+	for (int i = 1; i <= regions; i++)
 	{
-		// Make sure we don't run out of memory
-		if (centroidCount >= CCLCenters.width()) break;
-
 		// Check that we're looking at a parent region
-		if (COMs(i, 0) != 0)
+		Region& region = RegionData[i];
+		if (region.xSum != 0)
 		{
-			int pixelCount = COMs(i, 3);
+			int pixelCount = region.pixelCount;
 			// Check if region is too small
 			if (pixelCount < minPix) {
 				// Skip it
@@ -338,137 +687,113 @@ void Centroid::CoMMethod(std::vector<unsigned char>& Buffer, char* pMem, int pPi
 				continue;
 			}
 			// Region is not too large, calculate CoM
-			float xCOM = COMs(i, 0) / ((float)COMs(i, 2));
-			float yCOM = COMs(i, 1) / ((float)COMs(i, 2));
-			float avgPixIntensity = COMs(i, 2) / ((float)COMs(i, 3));
+			float xCOM = region.xSum / ((float)region.intensity);
+			float yCOM = region.ySum / ((float)region.intensity);
+			float avgPixIntensity = region.intensity / ((float)region.pixelCount);
 
 			// Add centroid to list
-			CCLCenters(centroidCount, 0) = xCOM;
-			CCLCenters(centroidCount, 1) = yCOM;
-			CCLCenters(centroidCount, 2) = avgPixIntensity;
-			centroidCount++;
+			addCentroid(0, CCLCount, xCOM, yCOM, avgPixIntensity);
 		}
 	}
-
-	Centroids[0] = CCLCenters;
 }
 
 // Hybrid Gradient - CoM (HGCM) method
 // (Finds gradient intensity for large regions, otherwise finds CoM)
-void Centroid::HGCMMethod(std::vector<unsigned char>& Buffer, char* pMem, int pPitch) {
-	CImg<float> HybridCenters(2500, 3); // (xCenter, yCenter, avgPixIntensity)
-	HybridCenters.fill(0);
-	int centroidCount = 0; // Keep track of number of centroids found
+template <typename Pixel>
+void Centroid::HGCMMethod(char* pMem, int pPitch) {
+	HybridCount = 0; // Keep track of number of centroids found
 
 	// First get regions and find CoM for small regions
-	CoMMethod(Buffer, pMem, pPitch);
+	CoMMethod<Pixel>(pMem, pPitch);
+	Timer hgcm;
+	groupLargeRegionRuns();
 
 	// Go through the regions that have too many pixels and use gradient method to find spot centers
-	for (int i = 0; i < regions; i++) {
+	for (int i = 1; i <= regions; i++) {
 		// Check that the region is too large
-		int pixelCount = COMs(i, 3);
+		Region& region = RegionData[i];
+		int pixelCount = region.pixelCount;
 		if (pixelCount < maxPix) {
 			continue;
 		}
 
-		CImg<float> tempHybridCenters(100, 2);	// Need to keep track of all zero-crossings
-												// If they are too close to each other, need to only keep one
-		int tempHybridCount = 0;
-		tempHybridCenters.fill(0);
+		// Need to keep track of all zero-crossings
+		// If they are too close to each other, they are merged into one
+		HybridCandidates.clear();
 
-		// Look at small window centered around CoM of region
-		int windowSize = 40;
-		int xCOM = COMs(i, 0) / COMs(i, 2); // This doesn't matter much so no need to worry
-		int yCOM = COMs(i, 1) / COMs(i, 2); // about rounding errors
-
-		int yStart = yCOM - windowSize / 2; int yEnd = yCOM + windowSize / 2;
+		// Only look at the region's own pixels, inside its bounding box
+		// (leaving room at the edges of the AoI for the gradient test)
+		int yStart = region.yMin; int yEnd = region.yMax + 1;
 		if (yStart < yLowerBound+1) yStart = yLowerBound+1;
 		if (yEnd > yUpperBound-2) yEnd = yUpperBound-2;
-		int xStart = xCOM - windowSize / 2; int xEnd = xCOM + windowSize / 2;
+		int xStart = region.xMin; int xEnd = region.xMax + 1;
 		if (xStart < xLowerBound+1) xStart = xLowerBound+1;
 		if (xEnd > xUpperBound-2) xEnd = xUpperBound-2;
+		if (yStart >= yEnd || xStart >= xEnd) {
+			continue;
+		}
 
-		for (int Y = yStart; Y < yEnd; Y++) {
-			for (int X = xStart; X < xEnd; X++) {
-				if (tempHybridCount >= tempHybridCenters.width()) break;
-				// Make sure the pixel we're looking at is in the region we're looking at 
-				int pixRegion = RegionImage(X, Y);
-				if (RegionVector(pixRegion, 2) == i)
-				{
-					// Check if the gradient of intensity crosses zero
-					// The equalities here are equivalent to checking if ddx(X) > 0 and ddx(X+1) <= 0 (etc)
-					if (Image(X, Y+1) >= Image(X, Y-1) && Image(X, Y) > Image(X, Y+2)) {
-						if (Image(X+1, Y) >= Image(X-1, Y) && Image(X, Y) > Image(X+2, Y)) {
-							// Approximate derivative as line and calculate zero-crossing
-							// (again, not actually using derivative but mathematically equivalent)
-							float rootX = X + (Image(X+1,Y) - Image(X-1,Y)) / (1.0*(Image(X,Y) + Image(X+1,Y) - Image(X+2,Y) - Image(X-1,Y)));
-							float rootY = Y + (Image(X,Y+1) - Image(X,Y-1)) / (1.0*(Image(X,Y) + Image(X,Y+1) - Image(X,Y+2) - Image(X,Y-1)));
-							
-							tempHybridCenters(tempHybridCount, 0) = rootX;
-							tempHybridCenters(tempHybridCount, 1) = rootY;
-							tempHybridCount++;
-						}
-					}
+		// Go through each of the region's pixels
+		for (int r = region.firstRun; r < region.firstRun + region.runCount; r++) {
+			PixelRun& run = LargeRegionRuns[r];
+			int Y = run.Y;
+			if (Y < yStart || Y >= yEnd) continue;
+			int runStart = (run.xStart > xStart) ? run.xStart : xStart;
+			int runEnd = (run.xEnd < xEnd) ? run.xEnd : xEnd;
+			const Pixel* above = Image.row<Pixel>(Y-1);
+			const Pixel* row = Image.row<Pixel>(Y);
+			const Pixel* below = Image.row<Pixel>(Y+1);
+			const Pixel* below2 = Image.row<Pixel>(Y+2);
+
+			// Find the pixels where the gradient of intensity crosses zero, a block at a time
+			for (int X = runStart; X < runEnd; X += GradientBlockSize) {
+				int length = runEnd - X;
+				if (length > GradientBlockSize) length = GradientBlockSize;
+				unsigned int peaks = UseScalarGradient ? gradientPeakMaskScalar(above, row, below, below2, X, length)
+					: gradientPeakMask(above, row, below, below2, X, length, Image.width());
+
+				for (int bit = 0; peaks != 0; bit++, peaks >>= 1) {
+					if ((peaks & 1) == 0) continue;
+					int peakX = X + bit;
+					// Approximate derivative as line and calculate zero-crossing
+					// (not actually using derivative but mathematically equivalent)
+					float rootX = peakX + (row[peakX+1] - row[peakX-1]) / (1.0*(row[peakX] + row[peakX+1] - row[peakX+2] - row[peakX-1]));
+					float rootY = Y + (below[peakX] - above[peakX]) / (1.0*(row[peakX] + below[peakX] - below2[peakX] - above[peakX]));
+					HybridCandidates.add(rootX, rootY, row[peakX]);
 				}
 			}
 		}
 
 		// Get rid of double-counted spots (i.e. nearby calculated centroids) and add to centroids list
-		for (int k = 0; k <= tempHybridCount; k++)
-		{
-			if (centroidCount >= HybridCenters.width()) break;
-			float Xk = tempHybridCenters(k, 0);
-			float Yk = tempHybridCenters(k, 1);
-			if (Xk == 0)
-			{ 
-				// Don't need to worry about these
-				continue;
-			}
-			for (int l = k + 1; l <= tempHybridCount; l++)
-			{
-				float Xl = tempHybridCenters(l, 0);
-				float Yl = tempHybridCenters(l, 1);
-				if (Xl == 0)
-				{ // Don't need to worry about these
-					continue;
-				}
-				if (Xl - 1.5 < Xk && Xk < Xl + 1.5)
-				{
-					if (Yl - 1.5 < Yk && Yk < Yl + 1.5)
-					{
-						float pixL = Image(Xl, Yl);
-						float pixK = Image(Xk, Yk); // Intensities of each pixel
-						// Calculate weighted average of both centers
-						float rootX = (pixL * Xl + pixK * Xk) / (pixL + pixK);
-						float rootY = (pixL * Yl + pixK * Yk) / (pixL + pixK);
-						// Update centerL and destroy centerK
-						tempHybridCenters(k, 0) = rootX;
-						tempHybridCenters(k, 1) = rootY;
-						tempHybridCenters(l, 0) = 0;
-						tempHybridCenters(l, 1) = 0;
-					}
-				}
-			}
-			// Add centers to list of centroids
-			HybridCenters(centroidCount, 0) = tempHybridCenters(k, 0);
-			HybridCenters(centroidCount, 1) = tempHybridCenters(k, 1);
-			centroidCount++;
+		HybridCandidates.merge();
+		for (int k = 0; k < HybridCandidates.centerCount; k++) {
+			addCentroid(1, HybridCount, HybridCandidates.centers[k].X, HybridCandidates.centers[k].Y, 0);
 		}
 	}
+	hgcmTime = hgcm.end();
+}
 
-	Centroids[1] = HybridCenters;
+// Centroid an image of Pixel type with the hybrid method or just CoM
+// (Each combination is compiled separately so the inner loops are specialized for it)
+template <typename Pixel, bool Hybrid>
+void Centroid::centroidImage(char* pMem, int pPitch)
+{
+	if (Hybrid) {
+		HGCMMethod<Pixel>(pMem, pPitch);
+	} else {
+		CoMMethod<Pixel>(pMem, pPitch);
+	}
 }
 
-void Centroid::centroid(std::vector<unsigned char>& Buffer, char* pMem, int pPitch)
+void Centroid::centroid(char* pMem, int pPitch)
 {
 	// Start calculation stopwatch
 	Timer compute;
 
-	if (UseHybridMethod) {
-		HGCMMethod(Buffer, pMem, pPitch);
-	} else {
-		CoMMethod(Buffer, pMem, pPitch);
-	}
+	CCLCount = 0;
+	HybridCount = 0;
+	hgcmTime = 0;
+	(this->*centroidFunction)(pMem, pPitch);
 
 	// Check if LED was on
 	if ((LEDIntensity / LEDCount) > 2 * (NoiseIntensity / NoiseCount)) {
@@ -478,18 +803,3 @@ void Centroid::centroid(std::vector<unsigned char>& Buffer, char* pMem, int pPit
 	// Stop computation stopwatch
 	computationTime = compute.end();
 }
-
-// Update the image buffer data
-void Centroid::updateBuffer(std::vector<unsigned char>& Buffer, int X, int Y, int imageWidth, unsigned char pixValue)
-{
-	unsigned char pixMultiplier = 5;
-	int dataIndex = 4 * (imageWidth * Y + X); // dataIndex + (0,1,2,3) == (R,G,B,A)
-	if (255 - pixMultiplier*pixValue >= 0)
-	{
-		Buffer[dataIndex + 3] = 255 - pixMultiplier*pixValue;
-	}
-	else
-	{
-		Buffer[dataIndex + 3] = 0;
-	}
-}
\ No newline at end of file
@@ -0,0 +1,464 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMULATION_SSE2
+#endif
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <math.h>
+
+/*
+
+FastImageSimulator makes the same kind of images as ImageSimulator (same
+	settings, same spot distributions), fast enough to simulate kilohertz
+	frame rates, so the centroiding pipeline can be load tested without the camera
+
+Instead of rand() per pixel and exp() per spot pixel, it uses
+	- CounterRandom, a counter-based random number generator: number n of a
+		stream is a hash of n and the stream's keys, so any part of a stream
+		can be made independently (4 noise pixels come from each number)
+	- fillNoise(), which makes the noise 16 pixels at a time with SSE2
+		(or a scalar loop without SSE2, e.g. on ARM Macs, that makes exactly
+		the same image)
+	- Gaussian stamp tables: one row of the separable spot profile for every
+		spot width and every 1/SubpixelSteps pixel offset of the center,
+		made once in the constructor, so a spot is just a table lookup and a
+		multiply per pixel (spot centers are rounded to 1/SubpixelSteps pixel,
+		and spotCenters holds the rounded centers)
+The same seed always gives the same image
+
+PregeneratedFrames runs a FastImageSimulator on a background thread, keeping a
+	ring of simulated frames ready ahead of when they are needed
+
+(centroid.h and simulation.h have to be included before this file)
+
+*/
+
+const int SubpixelSteps = 16;			// Spot centers are rounded to 1/SubpixelSteps pixel
+const int StampSize = 18;				// Spots cover StampSize x StampSize pixels (8 left/above the center pixel, 9 right/below)
+const int StampWidthCount = 50;			// Spot widths are 10.0, 10.1, ... 14.9 (like ImageSimulator)
+
+// One round of a 32-bit integer hash (lowbias32)
+inline unsigned int hashRound(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Counter-based random numbers, number n of a stream only depends on n and the stream's keys
+class CounterRandom
+{
+public:
+	unsigned int key1;
+	unsigned int key2;
+	unsigned int counter = 0;	// Number next() returns
+
+	CounterRandom(unsigned int seed, unsigned int stream);
+	unsigned int at(unsigned int n);
+	unsigned int next();
+	int below(int n);
+	float uniform();
+};
+
+// Stream number stream of seed (different streams are independent)
+CounterRandom::CounterRandom(unsigned int seed, unsigned int stream)
+{
+	key1 = hashRound(seed ^ 0x9E3779B9U);
+	key2 = hashRound(key1 + stream * 0x85EBCA6BU + 1);
+}
+
+// Number n of the stream
+inline unsigned int CounterRandom::at(unsigned int n)
+{
+	return hashRound(hashRound(n + key1) ^ key2);
+}
+
+// Next number of the stream
+unsigned int CounterRandom::next()
+{
+	return at(counter++);
+}
+
+// Integer from 0 to n - 1
+int CounterRandom::below(int n)
+{
+	return (int)(((unsigned long long)next() * (unsigned int)n) >> 32);
+}
+
+// Number from 0 to 1 (not including 1)
+float CounterRandom::uniform()
+{
+	return (next() >> 8) * (1.0f / 16777216);
+}
+
+#if defined(SIMULATION_SSE2)
+// Low 32 bits of a * b for each lane (SSE2 only multiplies lanes 0 and 2 at once)
+inline __m128i multiplyLow32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+inline __m128i hashRound(__m128i x)
+{
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+	x = multiplyLow32(x, _mm_set1_epi32(0x7feb352d));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+	x = multiplyLow32(x, _mm_set1_epi32((int)0x846ca68bU));
+	return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+#endif
+
+// Fill count pixels with noise from 0 to 4
+// (Pixel p is byte p % 4 of random.at(p / 4), scaled from 0-255 down to 0-4)
+void fillNoise(char* pixels, int count, CounterRandom& random)
+{
+	int p = 0;
+#if defined(SIMULATION_SSE2)
+	__m128i counters = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(random.key1));
+	__m128i key2 = _mm_set1_epi32(random.key2);
+	__m128i five = _mm_set1_epi16(5);
+	__m128i zero = _mm_setzero_si128();
+	for (; p + 16 <= count; p += 16) {
+		__m128i bytes = hashRound(_mm_xor_si128(hashRound(counters), key2));
+		counters = _mm_add_epi32(counters, _mm_set1_epi32(4));
+		// byte * 5 / 256 in 16 bits
+		__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(bytes, zero), five), 8);
+		__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(bytes, zero), five), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + p), _mm_packus_epi16(low, high));
+	}
+#endif
+	for (; p < count; p++) {
+		unsigned int byte = (random.at(p / 4) >> (8 * (p % 4))) & 255;
+		pixels[p] = (char)((byte * 5) >> 8);
+	}
+}
+
+// Parts of the Centroid object a simulated image depends on
+struct SimulationArea
+{
+	int centerX;		// Center of the centroiding AoI
+	int centerY;
+	int LEDxLowerBound;
+	int LEDxUpperBound;
+	int LEDyLowerBound;
+	int LEDyUpperBound;
+
+	void copy(Centroid& img);
+};
+
+void SimulationArea::copy(Centroid& img)
+{
+	centerX = img.xLowerBound + (img.xUpperBound - img.xLowerBound) / 2;
+	centerY = img.yLowerBound + (img.yUpperBound - img.yLowerBound) / 2;
+	LEDxLowerBound = img.LEDxLowerBound;
+	LEDxUpperBound = img.LEDxUpperBound;
+	LEDyLowerBound = img.LEDyLowerBound;
+	LEDyUpperBound = img.LEDyUpperBound;
+}
+
+class FastImageSimulator
+{
+public:
+	bool isIROn = false;					// Add in ability to make "IR On" images different
+	bool useLED = true;						// Whether to add in intensity to simulate IR LED
+	int baseNumberOfSpots = 55;				// Base number of electron spots to add to simulated image
+	int numberOfSpotsVariation = 10;		// Variation of the number of electron spots
+	std::vector<float> IROffRadii = {50, 90, 170, 300};
+	std::vector<float> IROffWeights = {2, 4, 3, 1};
+	std::vector<float> IROnRadii = {50, 90, 120, 170, 300};
+	std::vector<float> IROnWeights = {2, 3, 2, 2, 1};
+	std::vector<SimulatedSpot> spotCenters;	// Spots of the last simulated image
+	SimulationArea area;					// AoI center and LED area the images are for
+
+	FastImageSimulator();
+	void simulateImage(std::vector<char>& simImage, unsigned int randSeed, int width, int height, Centroid& img);
+	void simulateImage(char* simImage, unsigned int randSeed, int width, int height);
+
+private:
+	// stamps[(StampWidthCount * subpixel + width) * StampSize + i] is the spot profile i - 8 pixels from the
+	// center pixel, with the center subpixel / SubpixelSteps pixels past it
+	std::vector<float> stamps;
+
+	void addSpot(char* simImage, int width, int height, float centerX, float centerY, int widthX, int widthY, float percentIntensity);
+};
+
+// Make the stamp tables
+FastImageSimulator::FastImageSimulator()
+{
+	stamps.resize(SubpixelSteps * StampWidthCount * StampSize);
+	for (int subpixel = 0; subpixel < SubpixelSteps; subpixel++) {
+		for (int w = 0; w < StampWidthCount; w++) {
+			float spotWidth = (w + 100) / 10.0;
+			for (int i = 0; i < StampSize; i++) {
+				float distance = i - 8 - subpixel / (float)SubpixelSteps;
+				stamps[(StampWidthCount * subpixel + w) * StampSize + i] = sqrt(255) * exp(-distance * distance / spotWidth);
+			}
+		}
+	}
+}
+
+// Fill simImage (width x height pixels, 1 byte each) with a new simulated image for img's AoI and LED area
+void FastImageSimulator::simulateImage(std::vector<char>& simImage, unsigned int randSeed, int width, int height, Centroid& img)
+{
+	area.copy(img);
+	simulateImage(simImage.data(), randSeed, width, height);
+}
+
+// Fill simImage (width x height pixels, 1 byte each) with a new simulated image for area
+void FastImageSimulator::simulateImage(char* simImage, unsigned int randSeed, int width, int height)
+{
+	float const pi = 3.14159265358979;
+	// Separate streams for noise, LED and spots
+	CounterRandom noiseRandom(randSeed, 0);
+	CounterRandom LEDRandom(randSeed, 1);
+	CounterRandom random(randSeed, 2);
+
+	int numberOfSpots = random.below(numberOfSpotsVariation) + baseNumberOfSpots;
+	spotCenters.clear();
+	std::vector<float>& Radii = isIROn ? IROnRadii : IROffRadii;
+	std::vector<float>& PeakWeights = isIROn ? IROnWeights : IROffWeights;
+
+	// Add noise to the image
+	fillNoise(simImage, width * height, noiseRandom);
+
+	// Add in intensity to simulate IR LED
+	if (isIROn && useLED) {
+		for (int Y = area.LEDyLowerBound; Y < area.LEDyUpperBound; Y++) {
+			for (int X = area.LEDxLowerBound; X < area.LEDxUpperBound; X++) {
+				simImage[width * Y + X] = LEDRandom.below(40) + 80;
+			}
+		}
+	}
+	isIROn = !isIROn;
+
+	int PeakWeightSum = 0;
+	for (int i = 0; i < PeakWeights.size(); i++) {
+		PeakWeightSum += PeakWeights[i];
+	}
+	// If sum of peak weights is <= 0, don't add any spots to image
+	if (PeakWeightSum <= 0) return;
+
+	// Add spots
+	for (int spotNumber = 0; spotNumber < numberOfSpots; spotNumber++) {
+		int radiusProbability = random.below(1000*PeakWeightSum-1) / 1000;
+		int radiusIndex = -1;
+		int weightSum = 0;
+		while (radiusProbability >= weightSum) {
+			radiusIndex++;
+			weightSum += PeakWeights[radiusIndex];
+		}
+		float radius = Radii[radiusIndex];
+
+		// Using the physics def. of spherical coords
+		float phi = 2 * pi * random.uniform();			// (0, 2pi)
+		float costheta = 2.0 * random.uniform() - 1.0;	// (-1, 1)
+		float theta = acos(costheta);
+		float centerX = area.centerX + radius * sin(theta) * cos(phi); // Converting to Cartesian coords
+		float centerY = area.centerY + radius * cos(theta);
+		int widthX = random.below(StampWidthCount); // Widths btw 10.0 and 15.0 pixels
+		int widthY = random.below(StampWidthCount);
+		float percentIntensity = (random.below(60) + 50) / 100.0; // Choosing intensity btw 50% and 110%
+		addSpot(simImage, width, height, centerX, centerY, widthX, widthY, percentIntensity);
+	}
+}
+
+// Add a spot to the image, with its center rounded to the stamp tables
+void FastImageSimulator::addSpot(char* simImage, int width, int height, float centerX, float centerY, int widthX, int widthY, float percentIntensity)
+{
+	int pixelX = floor(centerX);
+	int pixelY = floor(centerY);
+	int subpixelX = (int)((centerX - pixelX) * SubpixelSteps + 0.5);
+	int subpixelY = (int)((centerY - pixelY) * SubpixelSteps + 0.5);
+	if (subpixelX == SubpixelSteps) {
+		pixelX++;
+		subpixelX = 0;
+	}
+	if (subpixelY == SubpixelSteps) {
+		pixelY++;
+		subpixelY = 0;
+	}
+	SimulatedSpot spot = { pixelX + subpixelX / (float)SubpixelSteps, pixelY + subpixelY / (float)SubpixelSteps, percentIntensity };
+	spotCenters.push_back(spot);
+
+	const float* stampX = &stamps[(StampWidthCount * subpixelX + widthX) * StampSize];
+	const float* stampY = &stamps[(StampWidthCount * subpixelY + widthY) * StampSize];
+	// Parts of spots that fall off the image are cut off
+	int firstX = (pixelX - 8 < 0) ? 8 - pixelX : 0;
+	int lastX = (pixelX - 8 + StampSize > width) ? width - pixelX + 8 : StampSize;
+	int firstY = (pixelY - 8 < 0) ? 8 - pixelY : 0;
+	int lastY = (pixelY - 8 + StampSize > height) ? height - pixelY + 8 : StampSize;
+	for (int i = firstY; i < lastY; i++) {
+		float rowIntensity = stampY[i] * percentIntensity;
+		unsigned char* row = reinterpret_cast<unsigned char*>(simImage) + (size_t)width * (pixelY - 8 + i) + pixelX - 8;
+		for (int j = firstX; j < lastX; j++) {
+			int intensity = row[j] + (int)(rowIntensity * stampX[j] + 0.5f);
+			row[j] = (intensity > 255) ? 255 : intensity; // Cuts off intensity at 255
+		}
+	}
+}
+
+// Simulated frame waiting in PregeneratedFrames
+struct PregeneratedFrame
+{
+	std::vector<char> image;			// 8-bit image
+	std::vector<SimulatedSpot> spots;	// True spot centers
+	unsigned int seed;					// Seed the image was made with
+};
+
+class PregeneratedFrames
+{
+public:
+	~PregeneratedFrames();
+	void start(FastImageSimulator& settings, int frameCount, int width, int height, unsigned int firstSeed);
+	void stop();
+	bool isRunning();
+	PregeneratedFrame* take(int timeout);
+	void release();
+	unsigned long long generatedCount();
+	unsigned long long waitCount();
+
+private:
+	FastImageSimulator simulator;
+	std::vector<PregeneratedFrame> frames;
+	int first = 0;				// Oldest ready frame
+	int count = 0;				// Ready frames (including one that is taken)
+	bool taken = false;			// Whether the oldest frame is being used
+	int width = 0;
+	int height = 0;
+	unsigned int nextSeed = 0;
+
+	std::thread generator;
+	std::mutex lock;
+	std::condition_variable frameReady;		// Signals take() that a frame was made
+	std::condition_variable frameFree;		// Signals the generator that a frame was released (or to stop)
+	bool running = false;
+	bool stopping = false;
+	unsigned long long generated = 0;		// Frames made
+	unsigned long long waits = 0;			// Times take() had to wait for a frame
+
+	void generate();
+};
+
+PregeneratedFrames::~PregeneratedFrames()
+{
+	stop();
+}
+
+// Start making frameCount frames ahead on a background thread, with the settings (and area) of settings
+// (Seeds count up from firstSeed)
+void PregeneratedFrames::start(FastImageSimulator& settings, int frameCount, int width, int height, unsigned int firstSeed)
+{
+	stop();
+	if (frameCount < 1) return;
+	simulator = settings;
+
+	// Allocate every frame now, so nothing is allocated while running
+	frames.resize(frameCount);
+	for (int i = 0; i < frameCount; i++) {
+		frames[i].image.assign((size_t)width * height, 0);
+		frames[i].spots.reserve(settings.baseNumberOfSpots + settings.numberOfSpotsVariation);
+	}
+	this->width = width;
+	this->height = height;
+	nextSeed = firstSeed;
+	first = 0;
+	count = 0;
+	taken = false;
+	generated = 0;
+	waits = 0;
+	stopping = false;
+	running = true;
+	generator = std::thread(&PregeneratedFrames::generate, this);
+}
+
+// Stop the background thread (frames left are thrown away)
+void PregeneratedFrames::stop()
+{
+	if (!running) return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	frameFree.notify_all();
+	generator.join();
+	running = false;
+}
+
+// Whether frames are being made
+bool PregeneratedFrames::isRunning()
+{
+	return running;
+}
+
+// Oldest ready frame, waiting up to timeout ms for one if none are ready (nullptr if there still aren't any)
+// The frame stays valid until release()
+PregeneratedFrame* PregeneratedFrames::take(int timeout)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (!running || taken) return nullptr;
+	if (count == 0) {
+		waits++;
+		frameReady.wait_for(guard, std::chrono::milliseconds(timeout), [this]() { return count > 0; });
+		if (count == 0) return nullptr;
+	}
+	taken = true;
+	return &frames[first];
+}
+
+// Done with the frame from take(), so it can be made again
+void PregeneratedFrames::release()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!taken) return;
+		taken = false;
+		first = (first + 1) % frames.size();
+		count--;
+	}
+	frameFree.notify_one();
+}
+
+// Frames made since start()
+unsigned long long PregeneratedFrames::generatedCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return generated;
+}
+
+// Times take() found no frame ready since start() (the generator couldn't keep up)
+unsigned long long PregeneratedFrames::waitCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return waits;
+}
+
+// Background thread loop, makes frames whenever there is room in the ring
+void PregeneratedFrames::generate()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		while (!stopping && count == frames.size()) {
+			frameFree.wait(guard);
+		}
+		if (stopping) return;
+
+		// Only this thread touches frames past the ready ones, so simulating doesn't need the lock
+		PregeneratedFrame& frame = frames[(first + count) % frames.size()];
+		frame.seed = nextSeed++;
+		guard.unlock();
+		simulator.simulateImage(frame.image.data(), frame.seed, width, height);
+		frame.spots.assign(simulator.spotCenters.begin(), simulator.spotCenters.end());
+		guard.lock();
+
+		count++;
+		generated++;
+		frameReady.notify_one();
+	}
+}
@@ -0,0 +1,255 @@
+#include <condition_variable>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+/*
+
+FrameRing keeps track of a ring of image memories the camera writes into, so
+	a frame that takes longer than the trigger period to centroid doesn't stop
+	the camera from having somewhere to put the next one
+
+The camera (the uEye driver, or the simulator) writes each frame into the next
+	memory that isn't being processed, and reports it with frameWritten()
+The processing thread takes frames in order with takeFrame(), which locks the
+	memory until release()
+The ring must not be cleared while a frame is taken, so whoever clears it has
+	to hold the same lock the processing thread holds from takeFrame() to
+	release() (imageLock in the camera addons)
+Frames are numbered by the camera, so any frame numbers that were never
+	processed (overwritten before their turn, or never written) are counted
+	as skipped, and the most recent ones are kept in skippedFrames
+
+*/
+
+const int SkippedFramesKept = 64;	// Most recent skipped frame numbers that are kept
+
+// One image memory of the ring
+struct RingFrame
+{
+	char* pMem;						// Image memory
+	int memID;						// ID of the memory (for the uEye driver)
+	unsigned long long frameNumber;	// Number of the frame in the memory
+	bool isNew;						// Whether the frame hasn't been taken yet
+	bool locked;					// Whether the frame is being processed
+};
+
+class FrameRing
+{
+public:
+	std::vector<RingFrame> frames;
+	int memoryBytes = 0;			// Size of each memory (set by whoever adds them)
+
+	void clear();
+	void add(char* pMem, int memID);
+	int size();
+
+	// Camera side
+	RingFrame* nextWriteFrame();
+	void frameWritten(RingFrame* frame, unsigned long long frameNumber);
+
+	// Processing side
+	RingFrame* takeFrame();
+	RingFrame* waitForFrame(int timeout);
+	bool waitForNewFrame(int timeout);
+	void release(RingFrame* frame);
+	unsigned long long processedCount();
+	unsigned long long skippedCount();
+	std::vector<unsigned long long> recentSkippedFrames();
+
+private:
+	std::mutex lock;
+	std::condition_variable frameReady;		// Signals waitForFrame() and waitForNewFrame() that a frame was written
+	int lastWritten = -1;					// Index of the last memory written
+	bool anyProcessed = false;
+	unsigned long long lastProcessed = 0;	// Number of the last frame processed
+	unsigned long long processed = 0;		// Frames processed
+	unsigned long long skipped = 0;			// Frame numbers skipped
+	std::vector<unsigned long long> skippedFrames;	// Circular list of the last SkippedFramesKept skipped numbers
+	int nextSkipped = 0;					// Where the next skipped number goes once the list is full
+
+	RingFrame* oldestNewFrame();
+	void addSkipped(unsigned long long frameNumber);
+};
+
+// Remove all memories and reset the counts
+// (No frame may be taken, since its pointer would be left dangling)
+void FrameRing::clear()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	frames.clear();
+	memoryBytes = 0;
+	lastWritten = -1;
+	anyProcessed = false;
+	lastProcessed = 0;
+	processed = 0;
+	skipped = 0;
+	skippedFrames.clear();
+	nextSkipped = 0;
+}
+
+// Add an image memory to the ring
+void FrameRing::add(char* pMem, int memID)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	RingFrame frame = { pMem, memID, (unsigned long long)-1, false, false }; // (No frame number yet)
+	frames.push_back(frame);
+}
+
+// Number of memories in the ring
+int FrameRing::size()
+{
+	return frames.size();
+}
+
+// Memory the camera should write the next frame into (the next one after the last written that isn't locked)
+// Returns nullptr if every memory is being processed
+RingFrame* FrameRing::nextWriteFrame()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	for (int i = 1; i <= frames.size(); i++) {
+		int index = (lastWritten + i) % frames.size();
+		if (!frames[index].locked) {
+			// (A frame in it that wasn't taken yet is lost, and won't be taken while it is written)
+			frames[index].isNew = false;
+			lastWritten = index;
+			return &frames[index];
+		}
+	}
+	return nullptr;
+}
+
+// The camera finished writing frame number frameNumber into frame
+// (A frame that hadn't been taken yet is replaced, and its number will count as skipped)
+void FrameRing::frameWritten(RingFrame* frame, unsigned long long frameNumber)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (frame->locked) return;
+		frame->frameNumber = frameNumber;
+		frame->isNew = true;
+		lastWritten = frame - &frames[0];
+	}
+	frameReady.notify_one();
+}
+
+// Oldest frame that hasn't been taken yet (lock must be held)
+RingFrame* FrameRing::oldestNewFrame()
+{
+	RingFrame* oldest = nullptr;
+	for (int i = 0; i < frames.size(); i++) {
+		RingFrame& frame = frames[i];
+		if (!frame.isNew || frame.locked) continue;
+		// (Frames older than the last one processed came too late to be in order, so they are dropped)
+		if (anyProcessed && frame.frameNumber <= lastProcessed) {
+			frame.isNew = false;
+			continue;
+		}
+		if (oldest == nullptr || frame.frameNumber < oldest->frameNumber) {
+			oldest = &frame;
+		}
+	}
+	return oldest;
+}
+
+// Take the oldest new frame to process (its memory won't be written until release())
+// Returns nullptr if there are no new frames
+RingFrame* FrameRing::takeFrame()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	RingFrame* frame = oldestNewFrame();
+	if (frame != nullptr) {
+		frame->isNew = false;
+		frame->locked = true;
+	}
+	return frame;
+}
+
+// Same as takeFrame(), but waits up to timeout ms for a frame to be written
+RingFrame* FrameRing::waitForFrame(int timeout)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	RingFrame* frame = oldestNewFrame();
+	if (frame == nullptr) {
+		frameReady.wait_for(guard, std::chrono::milliseconds(timeout));
+		frame = oldestNewFrame();
+	}
+	if (frame != nullptr) {
+		frame->isNew = false;
+		frame->locked = true;
+	}
+	return frame;
+}
+
+// Wait up to timeout ms for a frame to be written, without taking it
+// Returns whether there is a new frame to take
+// (So the processing thread can wait before locking anything, then take frames with takeFrame())
+bool FrameRing::waitForNewFrame(int timeout)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (oldestNewFrame() == nullptr) {
+		frameReady.wait_for(guard, std::chrono::milliseconds(timeout));
+	}
+	return oldestNewFrame() != nullptr;
+}
+
+// Done processing frame, so the camera can write to its memory again
+// (frame->frameNumber can be corrected before this if the camera says it is a different frame)
+void FrameRing::release(RingFrame* frame)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	frame->locked = false;
+	if (anyProcessed && frame->frameNumber > lastProcessed + 1) {
+		unsigned long long firstSkipped = lastProcessed + 1;
+		// (Only the last SkippedFramesKept numbers are kept, the rest are just counted)
+		if (frame->frameNumber - firstSkipped > SkippedFramesKept) {
+			skipped += frame->frameNumber - firstSkipped - SkippedFramesKept;
+			firstSkipped = frame->frameNumber - SkippedFramesKept;
+		}
+		for (unsigned long long number = firstSkipped; number < frame->frameNumber; number++) {
+			addSkipped(number);
+		}
+	}
+	if (!anyProcessed || frame->frameNumber > lastProcessed) {
+		lastProcessed = frame->frameNumber;
+	}
+	anyProcessed = true;
+	processed++;
+}
+
+// Count a skipped frame number (lock must be held)
+void FrameRing::addSkipped(unsigned long long frameNumber)
+{
+	if (skippedFrames.size() < SkippedFramesKept) {
+		skippedFrames.push_back(frameNumber);
+	} else {
+		skippedFrames[nextSkipped] = frameNumber;
+		nextSkipped = (nextSkipped + 1) % SkippedFramesKept;
+	}
+	skipped++;
+}
+
+// Frames processed since the ring was set up
+unsigned long long FrameRing::processedCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return processed;
+}
+
+// Frame numbers skipped since the ring was set up
+unsigned long long FrameRing::skippedCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return skipped;
+}
+
+// The most recent skipped frame numbers (up to SkippedFramesKept), oldest first
+std::vector<unsigned long long> FrameRing::recentSkippedFrames()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	std::vector<unsigned long long> recent;
+	for (int i = 0; i < skippedFrames.size(); i++) {
+		recent.push_back(skippedFrames[(nextSkipped + i) % skippedFrames.size()]);
+	}
+	return recent;
+}
@@ -0,0 +1,111 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRADIENT_SSE2
+#endif
+
+/*
+
+Zero-crossing test of the hybrid (HGCM) method for a whole row segment at once
+
+Pixel (X,Y) is a candidate spot center if the intensity gradient crosses zero
+	between X and X+1 and between Y and Y+1, which (without actually taking
+	derivatives) is:
+		I(X,Y+1) >= I(X,Y-1) and I(X,Y) > I(X,Y+2)
+		I(X+1,Y) >= I(X-1,Y) and I(X,Y) > I(X+2,Y)
+gradientPeakMask() checks GradientBlockSize pixels with SSE2 compares (or a
+	plain scalar loop without SSE2, e.g. on ARM Macs) and returns a bit mask of
+	the candidates, so the sub-pixel roots only need to be calculated for the
+	few pixels whose bit is set
+There is a version for 8-bit pixels and for 16-bit pixels (Mono10/12/16)
+
+*/
+
+const int GradientBlockSize = 16;
+
+// Whether pixel X of row is a zero-crossing candidate
+// (above is row Y-1, below is row Y+1 and below2 is row Y+2)
+template <typename Pixel>
+bool isGradientPeak(const Pixel* above, const Pixel* row, const Pixel* below, const Pixel* below2, int X)
+{
+	return below[X] >= above[X] && row[X] > below2[X] && row[X+1] >= row[X-1] && row[X] > row[X+2];
+}
+
+// Scalar version of gradientPeakMask()
+template <typename Pixel>
+unsigned int gradientPeakMaskScalar(const Pixel* above, const Pixel* row, const Pixel* below, const Pixel* below2, int X, int length)
+{
+	unsigned int mask = 0;
+	for (int i = 0; i < length; i++) {
+		if (isGradientPeak(above, row, below, below2, X + i)) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+#if defined(GRADIENT_SSE2)
+inline __m128i loadPixels(const void* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+// a >= b for unsigned bytes is the same as max(a, b) == a
+inline __m128i greaterOrEqual(__m128i a, __m128i b)
+{
+	return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+// a >= b for unsigned 16-bit values is the same as (b - a, saturated at 0) == 0
+inline __m128i greaterOrEqual16(__m128i a, __m128i b)
+{
+	return _mm_cmpeq_epi16(_mm_subs_epu16(b, a), _mm_setzero_si128());
+}
+// Candidates among the 8 16-bit pixels starting at X (all bits of a lane are set if it is a candidate)
+inline __m128i gradientPeaks16(const unsigned short* above, const unsigned short* row, const unsigned short* below, const unsigned short* below2, int X)
+{
+	__m128i center = loadPixels(row + X);
+	// a > b is the same as !(b >= a)
+	__m128i isPeak = _mm_andnot_si128(greaterOrEqual16(loadPixels(below2 + X), center),
+		greaterOrEqual16(loadPixels(below + X), loadPixels(above + X)));
+	isPeak = _mm_andnot_si128(greaterOrEqual16(loadPixels(row + X + 2), center), isPeak);
+	return _mm_and_si128(greaterOrEqual16(loadPixels(row + X + 1), loadPixels(row + X - 1)), isPeak);
+}
+#endif
+
+// Bit i of the result is set if pixel X+i of row is a zero-crossing candidate, for i < length
+// (length must be at most GradientBlockSize, and X-1 ... X+length+1 must be inside the rows,
+// which are rowLength pixels long)
+unsigned int gradientPeakMask(const unsigned char* above, const unsigned char* row, const unsigned char* below, const unsigned char* below2, int X, int length, int rowLength)
+{
+	// The vector loads read X-1 ... X+GradientBlockSize+1, so they can only be used away from the end of the row
+	// (pixels past length are looked at too, but their bits are cleared)
+#if defined(GRADIENT_SSE2)
+	if (X + GradientBlockSize + 1 < rowLength) {
+		__m128i center = loadPixels(row + X);
+		// a > b is the same as !(b >= a)
+		__m128i isPeak = _mm_andnot_si128(greaterOrEqual(loadPixels(below2 + X), center),
+			greaterOrEqual(loadPixels(below + X), loadPixels(above + X)));
+		isPeak = _mm_andnot_si128(greaterOrEqual(loadPixels(row + X + 2), center), isPeak);
+		isPeak = _mm_and_si128(greaterOrEqual(loadPixels(row + X + 1), loadPixels(row + X - 1)), isPeak);
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(isPeak);
+		return mask & ((1u << length) - 1);
+	}
+#endif
+
+	return gradientPeakMaskScalar(above, row, below, below2, X, length);
+}
+
+// 16-bit version of gradientPeakMask() (same rules)
+unsigned int gradientPeakMask(const unsigned short* above, const unsigned short* row, const unsigned short* below, const unsigned short* below2, int X, int length, int rowLength)
+{
+	// Each half of the block is checked separately, then the 16-bit lanes are packed into bytes
+	// (packing keeps the order of the lanes)
+#if defined(GRADIENT_SSE2)
+	if (X + GradientBlockSize + 1 < rowLength) {
+		__m128i packed = _mm_packs_epi16(gradientPeaks16(above, row, below, below2, X),
+			gradientPeaks16(above, row, below, below2, X + GradientBlockSize / 2));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(packed);
+		return mask & ((1u << length) - 1);
+	}
+#endif
+
+	return gradientPeakMaskScalar(above, row, below, below2, X, length);
+}
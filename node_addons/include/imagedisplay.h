@@ -0,0 +1,142 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGEDISPLAY_SSE2
+#endif
+#include <math.h>
+#include <vector>
+
+/*
+
+ImageDisplay renders accumulated images (accumulatedimage.h) into RGBA pixels
+	for an ImageData, instead of ImageClasses.js looping over every pixel
+
+Each pixel's count v is mapped to a gray level
+	linear:	255 * contrast * v
+	sqrt:	255 * contrast * sqrt(v)
+	log:	255 * contrast * ln(1 + v)
+which is rounded and capped at 255, and written to all four channels (so
+	empty pixels are transparent, like the old display)
+For difference images (IR on - IR off) the subtracted image's count is taken
+	away first, and only positive differences (or only negative ones, if
+	negative is set) are shown
+
+The gray levels are kept in a table of whole RGBA pixels, from 0 up to the
+	count that first reaches 255 (or ImageDisplayMaxTable counts, for very low
+	contrasts with sqrt or log), so rendering is just a table lookup per pixel
+	(with the subtraction and clamping done 4 pixels at a time with SSE2)
+The table is only made again when the mapping or contrast changes
+
+*/
+
+const int ImageDisplayMaxTable = 1 << 16;	// Most counts the table has gray levels for
+
+enum class DisplayMapping { Linear, Sqrt, Log };
+
+class ImageDisplay
+{
+public:
+	void setMapping(DisplayMapping newMapping, double newContrast);
+	void render(unsigned char* rgba, const unsigned int* image, const unsigned int* subtract, int count, bool negative);
+
+private:
+	DisplayMapping mapping = DisplayMapping::Linear;
+	double contrast = -1;				// (No table made yet)
+	std::vector<unsigned int> table;	// RGBA pixel of each count
+	bool saturated = false;				// Whether the last entry of the table is the pixel of every larger count too
+
+	unsigned int pixel(unsigned int value);
+	void renderScalar(unsigned int* out, const unsigned int* image, const unsigned int* subtract, int count, bool negative);
+};
+
+// Use mapping at contrast for the next render()s
+void ImageDisplay::setMapping(DisplayMapping newMapping, double newContrast)
+{
+	if (newContrast < 0) newContrast = 0;
+	if (newMapping == mapping && newContrast == contrast) return;
+	mapping = newMapping;
+	contrast = newContrast;
+	table.clear();
+	saturated = true;
+	if (contrast == 0) { // (Everything is 0)
+		table.push_back(0);
+		return;
+	}
+	saturated = false;
+	for (int value = 0; value < ImageDisplayMaxTable; value++) {
+		table.push_back(pixel(value));
+		if ((table.back() & 0xFF) == 255) {
+			saturated = true;
+			break;
+		}
+	}
+}
+
+// RGBA pixel (gray level in every channel) of a count
+unsigned int ImageDisplay::pixel(unsigned int value)
+{
+	double mapped;
+	if (mapping == DisplayMapping::Sqrt) {
+		mapped = sqrt((double)value);
+	} else if (mapping == DisplayMapping::Log) {
+		mapped = log1p((double)value);
+	} else {
+		mapped = value;
+	}
+	double level = 255 * contrast * mapped + 0.5;
+	unsigned int gray = (level < 255) ? (unsigned int)level : 255;
+	return gray * 0x01010101;
+}
+
+// Render count pixels of image (minus subtract, if not nullptr) into rgba (4 bytes per pixel)
+// Only counts > 0 are shown, or only differences < 0 if negative is set
+void ImageDisplay::render(unsigned char* rgba, const unsigned int* image, const unsigned int* subtract, int count, bool negative)
+{
+	if (table.empty()) setMapping(mapping, 0);
+	unsigned int* out = reinterpret_cast<unsigned int*>(rgba); // (RGBA pixels are written whole, the same in any byte order)
+	int done = 0;
+#if defined(IMAGEDISPLAY_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i last = _mm_set1_epi32((int)table.size() - 1);
+	for (; done + 4 <= count; done += 4) {
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(image + done));
+		if (subtract != nullptr) {
+			__m128i other = _mm_loadu_si128(reinterpret_cast<const __m128i*>(subtract + done));
+			values = negative ? _mm_sub_epi32(other, values) : _mm_sub_epi32(values, other);
+			values = _mm_andnot_si128(_mm_cmplt_epi32(values, zero), values); // (Differences that aren't shown are 0)
+		}
+		// (Counts past the table are read as its last entry, which is only right if the table is saturated,
+		// and unsigned counts over 2^31 look negative here, so they're clamped as well)
+		__m128i beyond = _mm_or_si128(_mm_cmpgt_epi32(values, last), _mm_cmplt_epi32(values, zero));
+		if (!saturated && _mm_movemask_epi8(beyond) != 0) {
+			renderScalar(out + done, image + done, (subtract != nullptr) ? subtract + done : nullptr, 4, negative);
+			continue;
+		}
+		__m128i indices = _mm_or_si128(_mm_andnot_si128(beyond, values), _mm_and_si128(beyond, last));
+		unsigned int lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), indices);
+		out[done] = table[lanes[0]];
+		out[done + 1] = table[lanes[1]];
+		out[done + 2] = table[lanes[2]];
+		out[done + 3] = table[lanes[3]];
+	}
+#endif
+	renderScalar(out + done, image + done, (subtract != nullptr) ? subtract + done : nullptr, count - done, negative);
+}
+
+// Render count pixels one at a time
+void ImageDisplay::renderScalar(unsigned int* out, const unsigned int* image, const unsigned int* subtract, int count, bool negative)
+{
+	const unsigned int tableSize = (unsigned int)table.size();
+	for (int i = 0; i < count; i++) {
+		unsigned int value = image[i];
+		if (subtract != nullptr) {
+			int difference = negative ? (int)(subtract[i] - value) : (int)(value - subtract[i]);
+			value = (difference > 0) ? difference : 0;
+		}
+		if (value < tableSize) {
+			out[i] = table[value];
+		} else {
+			out[i] = saturated ? table.back() : pixel(value);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PRESCAN_SSE2
+#endif
+
+/*
+
+Prescan of a row of camera memory for pixels at or above threshold
+(8-bit pixels for Mono8, 16-bit pixels for Mono10/12/16)
+
+The row is split into blocks of PrescanBlockSize pixels, and each block is
+	checked all at once with SSE2 compares (or a plain scalar loop without SSE2,
+	e.g. on ARM Macs)
+Only the lit blocks then need to be looked at pixel by pixel, which on a
+	mostly dark VMI frame skips the vast majority of the image
+
+*/
+
+const int PrescanBlockSize = 16;
+
+// Whether any of the length pixels starting at row are >= threshold
+template <typename Pixel>
+bool anyPixelLit(const Pixel* row, int length, Pixel threshold)
+{
+	for (int i = 0; i < length; i++) {
+		if (row[i] >= threshold) return true;
+	}
+	return false;
+}
+
+// Find the blocks of row[0, length) that contain at least one pixel >= threshold
+// The offset of the first pixel of each lit block is written to litBlocks
+// (which needs room for length / PrescanBlockSize + 1 elements)
+// Returns the number of lit blocks. The last block may be shorter than PrescanBlockSize
+int findLitBlocks(const unsigned char* row, int length, unsigned char threshold, int* litBlocks)
+{
+	int litCount = 0;
+	int X = 0;
+
+#if defined(PRESCAN_SSE2)
+	// x >= threshold is the same as max(x, threshold) == x for unsigned bytes
+	__m128i vThreshold = _mm_set1_epi8((char)threshold);
+	for (; X + PrescanBlockSize <= length; X += PrescanBlockSize) {
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + X));
+		__m128i isLit = _mm_cmpeq_epi8(_mm_max_epu8(pixels, vThreshold), pixels);
+		if (_mm_movemask_epi8(isLit) != 0) {
+			litBlocks[litCount++] = X;
+		}
+	}
+#else
+	for (; X + PrescanBlockSize <= length; X += PrescanBlockSize) {
+		if (anyPixelLit(row + X, PrescanBlockSize, threshold)) {
+			litBlocks[litCount++] = X;
+		}
+	}
+#endif
+
+	// Leftover pixels at the end of the row
+	if (X < length && anyPixelLit(row + X, length - X, threshold)) {
+		litBlocks[litCount++] = X;
+	}
+
+	return litCount;
+}
+
+// 16-bit version of findLitBlocks() (blocks are the same number of pixels as for 8-bit pixels)
+int findLitBlocks(const unsigned short* row, int length, unsigned short threshold, int* litBlocks)
+{
+	int litCount = 0;
+	int X = 0;
+
+#if defined(PRESCAN_SSE2)
+	// x >= threshold is the same as (threshold - x, saturated at 0) == 0 for unsigned 16-bit values
+	// (Each block is two vectors of 8 pixels)
+	__m128i vThreshold = _mm_set1_epi16((short)threshold);
+	__m128i zero = _mm_setzero_si128();
+	for (; X + PrescanBlockSize <= length; X += PrescanBlockSize) {
+		__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + X));
+		__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + X + 8));
+		__m128i isLit = _mm_or_si128(_mm_cmpeq_epi16(_mm_subs_epu16(vThreshold, first), zero),
+			_mm_cmpeq_epi16(_mm_subs_epu16(vThreshold, second), zero));
+		if (_mm_movemask_epi8(isLit) != 0) {
+			litBlocks[litCount++] = X;
+		}
+	}
+#else
+	for (; X + PrescanBlockSize <= length; X += PrescanBlockSize) {
+		if (anyPixelLit(row + X, PrescanBlockSize, threshold)) {
+			litBlocks[litCount++] = X;
+		}
+	}
+#endif
+
+	// Leftover pixels at the end of the row
+	if (X < length && anyPixelLit(row + X, length - X, threshold)) {
+		litBlocks[litCount++] = X;
+	}
+
+	return litCount;
+}
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <vector>
+
+/*
+
+PreviewStage makes the RGBA preview image shown in the live view, separately
+	from centroiding, so frames nobody looks at cost nothing but centroiding
+
+A preview is only made when it is due:
+	- never while the stage is off (e.g. the live view window is closed)
+	- at most maxRate previews per second (0 means every frame)
+	- the next frame always, at full size, after requestFullImage()
+Each preview pixel is the brightest of a scale x scale block of image pixels
+	(so single lit pixels still show up when downscaled), and is black with
+	an alpha of 255 - 5 * (8-bit value), the same as the old image buffer
+
+render() writes the preview into the buffer given (resized to the preview
+	size) and marks it ready, then whoever sends the frame's results takes()
+	it, which clears ready again
+
+*/
+
+const int PreviewDefaultRate = 10;	// Previews per second by default (about what the live view can show)
+const int PreviewBuffersKept = 4;	// Most preview Buffers the addons keep after JS gives them back (see returnPreview())
+
+class PreviewStage
+{
+public:
+	bool enabled = true;			// Whether previews are made at all
+	double maxRate = PreviewDefaultRate;	// Most previews per second (0 means every frame)
+	int scale = 1;					// Image pixels per preview pixel, each way (1, 2 or 4)
+
+	// Last preview made
+	bool ready = false;				// Whether it hasn't been taken yet
+	int width = 0;					// Preview width (pixels)
+	int height = 0;					// Preview height (pixels)
+	int renderedScale = 1;			// Scale it was made at
+
+	void setScale(int newScale);
+	void requestFullImage();
+	bool render(std::vector<unsigned char>& buffer, const char* pMem, int pPitch, int imageWidth, int imageHeight, int bitDepth);
+	bool take();
+	unsigned long long renderedCount();
+
+private:
+	bool fullRequested = false;		// Whether the next frame is made at full size, even if not due
+	bool anyRendered = false;
+	std::chrono::steady_clock::time_point lastRender;
+	unsigned long long rendered = 0;	// Previews made since startup
+	std::vector<unsigned short> blockRow;	// Brightest pixel of each column over the rows of one block
+	unsigned char alphaTable[256];		// Alpha of each 8-bit pixel value
+
+	bool due();
+	template <typename Pixel> void renderPixels(std::vector<unsigned char>& buffer, const char* pMem, int pPitch, int imageWidth, int shift);
+};
+
+// Set the downscaling (anything but 2 or 4 means full size)
+void PreviewStage::setScale(int newScale)
+{
+	scale = (newScale == 2 || newScale == 4) ? newScale : 1;
+}
+
+// Make a full size preview of the next frame, whether or not one is due
+// (For saving a single shot)
+void PreviewStage::requestFullImage()
+{
+	fullRequested = true;
+}
+
+// Whether the frame being centroided should get a preview
+bool PreviewStage::due()
+{
+	if (fullRequested) return true;
+	if (!enabled) return false;
+	if (!anyRendered || maxRate <= 0) return true;
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - lastRender;
+	return elapsed.count() >= 1 / maxRate;
+}
+
+// Make a preview of the image at pMem into buffer, if one is due
+// Returns whether a preview was made
+bool PreviewStage::render(std::vector<unsigned char>& buffer, const char* pMem, int pPitch, int imageWidth, int imageHeight, int bitDepth)
+{
+	if (!due()) return false;
+	renderedScale = fullRequested ? 1 : scale;
+	fullRequested = false;
+	anyRendered = true;
+	lastRender = std::chrono::steady_clock::now();
+
+	width = imageWidth / renderedScale;
+	height = imageHeight / renderedScale;
+	buffer.resize(4 * width * height); // (Only allocates if the preview size changed)
+	for (int value = 0; value < 256; value++) {
+		alphaTable[value] = (5 * value < 255) ? 255 - 5 * value : 0;
+	}
+	if (bitDepth > 8) {
+		renderPixels<unsigned short>(buffer, pMem, pPitch, imageWidth, bitDepth - 8);
+	} else {
+		renderPixels<unsigned char>(buffer, pMem, pPitch, imageWidth, 0);
+	}
+	ready = true;
+	rendered++;
+	return true;
+}
+
+// Fill buffer with the preview of an image of Pixel type
+// (Pixels are shifted down by shift to 8 bits)
+template <typename Pixel>
+void PreviewStage::renderPixels(std::vector<unsigned char>& buffer, const char* pMem, int pPitch, int imageWidth, int shift)
+{
+	int blockSize = renderedScale;
+	blockRow.resize(imageWidth);
+	unsigned char* out = buffer.data();
+	for (int Y = 0; Y < height; Y++) {
+		// Brightest pixel of each column over the block's rows
+		const Pixel* row = reinterpret_cast<const Pixel*>(pMem + (size_t)Y * blockSize * pPitch);
+		for (int X = 0; X < imageWidth; X++) {
+			blockRow[X] = row[X];
+		}
+		for (int r = 1; r < blockSize; r++) {
+			row = reinterpret_cast<const Pixel*>(pMem + ((size_t)Y * blockSize + r) * pPitch);
+			for (int X = 0; X < imageWidth; X++) {
+				if (row[X] > blockRow[X]) blockRow[X] = row[X];
+			}
+		}
+		// Then of each block of columns
+		for (int X = 0; X < width; X++) {
+			unsigned int brightest = blockRow[X * blockSize];
+			for (int c = 1; c < blockSize; c++) {
+				if (blockRow[X * blockSize + c] > brightest) brightest = blockRow[X * blockSize + c];
+			}
+			brightest >>= shift;
+			out[0] = 0;
+			out[1] = 0;
+			out[2] = 0;
+			out[3] = alphaTable[(brightest < 255) ? brightest : 255];
+			out += 4;
+		}
+	}
+}
+
+// Take the last preview to send with the frame's results
+// Returns whether there was one that wasn't taken yet
+bool PreviewStage::take()
+{
+	bool wasReady = ready;
+	ready = false;
+	return wasReady;
+}
+
+// Previews made since startup
+unsigned long long PreviewStage::renderedCount()
+{
+	return rendered;
+}
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+
+Offline centroiding of frames saved by FrameRecorder
+
+RecordingReader maps a recording file (read only) and lists the frames it
+	holds, oldest first, skipping slots that were never written
+Recentroider centroids every frame of a recording again with new settings
+	(threshold, minPix, maxPix, method) and makes the centroid list and the
+	IR off / IR on accumulated images (binned like live ones, see accumulatedimage.h)
+	for each threshold
+Frames are handed out to one Centroid object per thread, and each frame is
+	centroided with every threshold of a sweep while it is still in cache,
+	so a sweep only reads the recording once
+LED state comes from the recording rather than being measured again
+Each frame is centroided with the recorded AoI as its bounds, inside the border
+	FrameRecorder saves around it, so spots at the edge of the AoI come out
+	the same as they did live
+
+(centroid.h, recorder.h and accumulatedimage.h have to be included before this file)
+
+*/
+
+// Centroid found in a recorded frame (in AoI coordinates, like sendCentroids())
+struct RecentroidedSpot
+{
+	float X;
+	float Y;
+	float intensity;	// Average pixel intensity
+	int method;			// 0 for CoM, 1 for HGCM
+};
+
+struct RecentroidSettings
+{
+	std::vector<unsigned int> thresholds = { 20 };	// Each one is a separate result
+	int minPix = 3;
+	int maxPix = 120;
+	bool useHybrid = true;
+	int threads = 0;		// 0 uses every core
+	int binSize = 1024;		// Size of the accumulated images
+};
+
+// Results for one threshold
+struct RecentroidResult
+{
+	unsigned int threshold;
+	std::vector<RecentroidedSpot> centroids;	// Centroids of every frame, in frame order
+	std::vector<unsigned int> frameStart;		// Index of each frame's first centroid (one more than the number of frames)
+	std::vector<unsigned int> IROffImage;		// Accumulated images (binSize x binSize, row by row)
+	std::vector<unsigned int> IROnImage;
+	unsigned long long IROffCount = 0;			// Electrons in each image
+	unsigned long long IROnCount = 0;
+};
+
+class RecordingReader
+{
+public:
+	RecordingHeader header;
+
+	~RecordingReader();
+	bool open(const std::string& path);
+	void close();
+	int frameCount();
+	const RecordedFrameHeader& frameHeader(int frame);
+	const char* framePixels(int frame);
+
+private:
+	const char* mapping = nullptr;
+	size_t fileSize = 0;
+	std::vector<size_t> frameOffsets;	// Offset of each valid slot, in frame order
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = NULL;
+#else
+	int fileDescriptor = -1;
+#endif
+};
+
+class Recentroider
+{
+public:
+	RecentroidSettings settings;
+	std::vector<RecentroidResult> results;	// One for each threshold
+	std::vector<unsigned char> frameLEDOn;	// Whether the LED was on in each frame
+	double computationTime = 0;				// Time to centroid all frames (ms)
+
+	void run(RecordingReader& recording);
+
+private:
+	// Centroiding state of one thread
+	struct Worker
+	{
+		Centroid img;
+	};
+	std::vector<std::unique_ptr<Worker> > workers;
+	ThreadPool pool;
+	RecordingReader* currentRecording = nullptr;
+	std::atomic<int> nextFrame;
+	std::vector<std::vector<RecentroidedSpot> > frameSpots;	// Centroids of each (threshold, frame)
+
+	static void runWorker(void* recentroider, int workerIndex);
+	void centroidFrame(Worker& worker, int frame);
+	void collectResults(int frames);
+};
+
+RecordingReader::~RecordingReader()
+{
+	close();
+}
+
+// Map the recording at path and find its frames
+// Returns false if the file can't be read or isn't a recording
+bool RecordingReader::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fileHandle, &size)) {
+		fileSize = size.QuadPart;
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	}
+	if (mappingHandle != NULL) {
+		mapping = reinterpret_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	}
+#else
+	fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) return false;
+	struct stat status;
+	if (fstat(fileDescriptor, &status) == 0 && status.st_size > 0) {
+		fileSize = status.st_size;
+		void* address = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+		if (address != MAP_FAILED) {
+			mapping = reinterpret_cast<const char*>(address);
+		}
+	}
+#endif
+	if (mapping == nullptr || fileSize < sizeof(RecordingHeader)) {
+		close();
+		return false;
+	}
+
+	// Check the file is a recording this version can read
+	memcpy(&header, mapping, sizeof(RecordingHeader));
+	bool valid = memcmp(header.magic, RecordingMagic, sizeof(header.magic)) == 0
+		&& header.frameHeaderSize == sizeof(RecordedFrameHeader)
+		&& header.slotSize >= sizeof(RecordedFrameHeader)
+		&& header.headerSize + (unsigned long long)header.slotSize * header.slotCount <= fileSize;
+	if (!valid) {
+		close();
+		return false;
+	}
+
+	// Slots hold frames framesWritten - slotCount ... framesWritten - 1 (some may have been dropped)
+	unsigned long long oldestFrame = (header.framesWritten > header.slotCount) ? header.framesWritten - header.slotCount : 0;
+	std::vector<std::pair<unsigned long long, size_t> > frames;
+	for (unsigned int slot = 0; slot < header.slotCount; slot++) {
+		size_t offset = header.headerSize + (size_t)slot * header.slotSize;
+		const RecordedFrameHeader* frame = reinterpret_cast<const RecordedFrameHeader*>(mapping + offset);
+		bool written = frame->frameIndex >= oldestFrame && frame->frameIndex < header.framesWritten
+			&& frame->frameIndex % header.slotCount == slot
+			&& frame->width > 0 && frame->height > 0
+			&& frame->borderLeft + frame->width <= frame->frameWidth && frame->borderTop + frame->height <= frame->frameHeight
+			&& frame->pitch == frame->frameWidth * header.bytesPerPixel
+			&& sizeof(RecordedFrameHeader) + (unsigned long long)frame->pitch * frame->frameHeight <= header.slotSize;
+		if (written) {
+			frames.push_back(std::make_pair(frame->frameIndex, offset));
+		}
+	}
+	std::sort(frames.begin(), frames.end());
+	for (int i = 0; i < frames.size(); i++) {
+		frameOffsets.push_back(frames[i].second);
+	}
+	return true;
+}
+
+// Unmap the recording
+void RecordingReader::close()
+{
+#ifdef _WIN32
+	if (mapping != nullptr) UnmapViewOfFile(mapping);
+	if (mappingHandle != NULL) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (mapping != nullptr) munmap(const_cast<char*>(mapping), fileSize);
+	if (fileDescriptor >= 0) ::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapping = nullptr;
+	fileSize = 0;
+	frameOffsets.clear();
+}
+
+// Number of frames in the recording
+int RecordingReader::frameCount()
+{
+	return frameOffsets.size();
+}
+
+// Header of a frame (0 is the oldest)
+const RecordedFrameHeader& RecordingReader::frameHeader(int frame)
+{
+	return *reinterpret_cast<const RecordedFrameHeader*>(mapping + frameOffsets[frame]);
+}
+
+// First pixel of a frame, the top left of the AoI's border (rows are frameHeader(frame).pitch bytes apart)
+const char* RecordingReader::framePixels(int frame)
+{
+	return mapping + frameOffsets[frame] + sizeof(RecordedFrameHeader);
+}
+
+// Centroid every frame of the recording with each threshold
+void Recentroider::run(RecordingReader& recording)
+{
+	Timer timer;
+	int frames = recording.frameCount();
+	int thresholdCount = settings.thresholds.size();
+
+	int threadCount = settings.threads;
+	if (threadCount < 1) threadCount = std::thread::hardware_concurrency();
+	if (threadCount < 1) threadCount = 1;
+	pool.setThreadCount(threadCount);
+	while (workers.size() < threadCount) {
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+	for (int i = 0; i < threadCount; i++) {
+		Centroid& img = workers[i]->img;
+		img.RegionData.assign(1500);
+		img.minPix = settings.minPix;
+		img.maxPix = settings.maxPix;
+		img.setHybridMethod(settings.useHybrid);
+		img.setBitDepth(recording.header.bitDepth);
+	}
+
+	frameSpots.assign(thresholdCount * frames, std::vector<RecentroidedSpot>());
+	frameLEDOn.assign(frames, false);
+	currentRecording = &recording;
+	nextFrame = 0;
+	pool.run(threadCount, &Recentroider::runWorker, this);
+	collectResults(frames);
+	currentRecording = nullptr;
+	computationTime = timer.end();
+}
+
+// Centroid frames until there are none left (one call per thread)
+void Recentroider::runWorker(void* recentroider, int workerIndex)
+{
+	Recentroider* self = static_cast<Recentroider*>(recentroider);
+	Worker& worker = *self->workers[workerIndex];
+	int frames = self->currentRecording->frameCount();
+	for (int frame = self->nextFrame++; frame < frames; frame = self->nextFrame++) {
+		self->centroidFrame(worker, frame);
+	}
+}
+
+// Centroid one frame with each threshold
+void Recentroider::centroidFrame(Worker& worker, int frame)
+{
+	const RecordedFrameHeader& header = currentRecording->frameHeader(frame);
+	char* pixels = const_cast<char*>(currentRecording->framePixels(frame)); // (Only read)
+	Centroid& img = worker.img;
+
+	// The frame is the AoI with the border around it that the camera image had
+	// (so the AoI's outermost pixels are centroided like they were live, AoI size can change during a recording)
+	if (img.Image.width() != (int)header.frameWidth || img.Image.height() != (int)header.frameHeight) {
+		img.Image.assign(header.frameWidth, header.frameHeight);
+	}
+	img.xLowerBound = header.borderLeft;
+	img.xUpperBound = header.borderLeft + header.width;
+	img.yLowerBound = header.borderTop;
+	img.yUpperBound = header.borderTop + header.height;
+	frameLEDOn[frame] = header.isLEDOn; // (Each frame is only written by one thread)
+
+	for (int t = 0; t < settings.thresholds.size(); t++) {
+		img.threshold = settings.thresholds[t];
+		img.centroid(pixels, header.pitch);
+
+		std::vector<RecentroidedSpot>& spots = frameSpots[t * frameLEDOn.size() + frame];
+		spots.resize(img.CCLCount + img.HybridCount);
+		int spot = 0;
+		for (int method = 0; method < 2; method++) {
+			int count = (method == 0) ? img.CCLCount : img.HybridCount;
+			for (int c = 0; c < count; c++) {
+				RecentroidedSpot& s = spots[spot++];
+				s.X = img.Centroids(method, c, 0) - img.xLowerBound;
+				s.Y = img.Centroids(method, c, 1) - img.yLowerBound;
+				s.intensity = img.Centroids(method, c, 2);
+				s.method = method;
+			}
+		}
+	}
+}
+
+// Gather each frame's centroids into one list per threshold, and make the accumulated images
+void Recentroider::collectResults(int frames)
+{
+	int binSize = settings.binSize;
+	results.resize(settings.thresholds.size());
+	for (int t = 0; t < settings.thresholds.size(); t++) {
+		RecentroidResult& result = results[t];
+		result.threshold = settings.thresholds[t];
+		result.centroids.clear();
+		result.frameStart.assign(frames + 1, 0);
+		result.IROffImage.assign(binSize * binSize, 0);
+		result.IROnImage.assign(binSize * binSize, 0);
+		result.IROffCount = 0;
+		result.IROnCount = 0;
+
+		for (int frame = 0; frame < frames; frame++) {
+			const RecordedFrameHeader& header = currentRecording->frameHeader(frame);
+			std::vector<RecentroidedSpot>& spots = frameSpots[t * frames + frame];
+			result.frameStart[frame] = result.centroids.size();
+			result.centroids.insert(result.centroids.end(), spots.begin(), spots.end());
+
+			// Bin the same way as live accumulated images
+			std::vector<unsigned int>& image = frameLEDOn[frame] ? result.IROnImage : result.IROffImage;
+			for (int i = 0; i < spots.size(); i++) {
+				int index = binIndex(spots[i].X, spots[i].Y, binSize, header.width, header.height);
+				if (index < 0) continue;
+				image[index]++;
+				if (frameLEDOn[frame]) result.IROnCount++;
+				else result.IROffCount++;
+			}
+			std::vector<RecentroidedSpot>().swap(spots); // (Free as we go)
+		}
+		result.frameStart[frames] = result.centroids.size();
+	}
+}
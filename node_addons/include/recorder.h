@@ -0,0 +1,337 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+
+FrameRecorder saves raw camera frames (just the centroiding AoI) to a ring file,
+	so that a run can be centroided again later with different settings
+The AoI is saved with a 1 pixel border around it (where the camera image has
+	one), since centroiding never looks at the outermost pixels of an image:
+	centroiding the saved frame with the AoI as its bounds then looks at the
+	same pixels live centroiding did
+
+The file is made its full size when recording starts and memory-mapped, and
+	frame n goes into slot n % slotCount, so once the file is full the oldest
+	frames are overwritten
+File layout (all values little-endian):
+	RecordingHeader at the start, padded to RecordingPageSize bytes
+	slotCount slots of slotSize bytes, each a RecordedFrameHeader followed by
+		the frame's rows, packed (pitch = frameWidth * bytes per pixel)
+record() only copies the frame into one of StagingFrameCount preallocated
+	buffers and returns, and a writer thread copies the buffers into the file,
+	so disk writes never hold up centroiding
+If the writer falls behind and all the buffers are full, the frame is dropped
+	(and counted), and its frame index is skipped in the file
+
+*/
+
+const int StagingFrameCount = 16;		// Frames that can wait for the writer
+const int RecordingPageSize = 4096;		// Header and slots are aligned to this
+const char RecordingMagic[8] = { 'V', 'M', 'I', 'R', 'A', 'W', '0', '2' };
+
+// Start of the recording file
+struct RecordingHeader
+{
+	char magic[8];						// RecordingMagic
+	unsigned int headerSize;			// Bytes before the first slot
+	unsigned int frameHeaderSize;		// Bytes of RecordedFrameHeader
+	unsigned int slotSize;				// Bytes per slot (frame header + frame, page aligned)
+	unsigned int slotCount;				// Number of slots in the ring
+	unsigned int bitDepth;				// Bits per pixel (more than 8 are stored in 2 bytes per pixel)
+	unsigned int bytesPerPixel;
+	unsigned long long framesWritten;	// Frames written so far (slots hold frames framesWritten - slotCount ... framesWritten - 1)
+};
+
+// Start of each slot
+struct RecordedFrameHeader
+{
+	unsigned long long frameIndex;		// Number of frames recorded before this one (including dropped ones)
+	unsigned long long timestamp;		// Microseconds since the Unix epoch when the frame was recorded
+	unsigned int isLEDOn;				// Whether the IR LED was on
+	unsigned int pitch;					// Bytes per row of the frame
+	unsigned int width;					// AoI size and position in the camera image
+	unsigned int height;
+	unsigned int xOffset;
+	unsigned int yOffset;
+	unsigned int frameWidth;			// Size of the saved frame (the AoI and its border)
+	unsigned int frameHeight;
+	unsigned int borderLeft;			// Border columns left of the AoI and rows above it (0 at the edge of the camera image, otherwise 1)
+	unsigned int borderTop;
+};
+
+class FrameRecorder
+{
+public:
+	FrameRecorder();
+	~FrameRecorder();
+	bool start(const std::string& path, int slotCount, int maxWidth, int maxHeight, int bitDepth);
+	void stop();
+	bool isRecording();
+	void record(const char* pMem, int pitch, int xOffset, int yOffset, int width, int height, bool isLEDOn);
+	unsigned long long framesRecorded();
+	unsigned long long framesDropped();
+
+private:
+	// Frame waiting to be written
+	struct StagedFrame
+	{
+		RecordedFrameHeader header;
+		std::vector<char> pixels;
+	};
+	StagedFrame staged[StagingFrameCount];
+	int stagedFirst = 0;		// Oldest staged frame
+	int stagedCount = 0;		// Staged frames the writer hasn't finished
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable framesReady;	// Signals the writer that a frame was staged (or to stop)
+	bool recording = false;
+	bool stopping = false;
+
+	unsigned long long frameIndex = 0;		// Index of the next frame
+	unsigned long long droppedCount = 0;	// Frames dropped because the writer fell behind
+	int bytesPerPixel = 1;
+	int imageWidth = 0;						// Size of the camera image (so the AoI's border stays inside it)
+	int imageHeight = 0;
+	size_t slotSize = 0;
+	size_t fileSize = 0;
+
+	// Mapped file
+	char* mapping = nullptr;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = NULL;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	bool mapFile(const std::string& path);
+	void unmapFile();
+	void write();
+};
+
+FrameRecorder::FrameRecorder()
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	stop();
+}
+
+// Start recording to the file at path, which holds the last slotCount frames
+// (frames up to maxWidth x maxHeight fit)
+// Returns false if the file couldn't be made
+bool FrameRecorder::start(const std::string& path, int slotCount, int maxWidth, int maxHeight, int bitDepth)
+{
+	stop();
+	if (slotCount < 1 || maxWidth < 1 || maxHeight < 1) return false;
+
+	bytesPerPixel = (bitDepth > 8) ? 2 : 1;
+	imageWidth = maxWidth;
+	imageHeight = maxHeight;
+	size_t frameSize = (size_t)maxWidth * maxHeight * bytesPerPixel;
+	slotSize = sizeof(RecordedFrameHeader) + frameSize;
+	slotSize = (slotSize + RecordingPageSize - 1) / RecordingPageSize * RecordingPageSize;
+	fileSize = RecordingPageSize + slotSize * slotCount;
+	if (!mapFile(path)) return false;
+
+	RecordingHeader header;
+	memcpy(header.magic, RecordingMagic, sizeof(header.magic));
+	header.headerSize = RecordingPageSize;
+	header.frameHeaderSize = sizeof(RecordedFrameHeader);
+	header.slotSize = slotSize;
+	header.slotCount = slotCount;
+	header.bitDepth = bitDepth;
+	header.bytesPerPixel = bytesPerPixel;
+	header.framesWritten = 0;
+	memcpy(mapping, &header, sizeof(header));
+
+	// Allocate the staging buffers now, so record() never has to
+	for (int i = 0; i < StagingFrameCount; i++) {
+		staged[i].pixels.assign(frameSize, 0);
+	}
+	stagedFirst = 0;
+	stagedCount = 0;
+	frameIndex = 0;
+	droppedCount = 0;
+	stopping = false;
+	recording = true;
+	writer = std::thread(&FrameRecorder::write, this);
+	return true;
+}
+
+// Write out the frames still staged, then close the file
+void FrameRecorder::stop()
+{
+	if (!recording) return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	framesReady.notify_all();
+	writer.join();
+	unmapFile();
+	recording = false;
+}
+
+// Whether frames are being recorded
+bool FrameRecorder::isRecording()
+{
+	return recording;
+}
+
+// Copy the AoI of the frame in pMem (pitch bytes per row), and its border, to be written to the file
+// (Frames that don't fit in the slots, or come while the writer is too far behind, are dropped)
+void FrameRecorder::record(const char* pMem, int pitch, int xOffset, int yOffset, int width, int height, bool isLEDOn)
+{
+	if (!recording) return;
+
+	// Add the border around the AoI, where the camera image has one
+	int frameLeft = (xOffset > 0) ? xOffset - 1 : 0;
+	int frameTop = (yOffset > 0) ? yOffset - 1 : 0;
+	int frameRight = (xOffset + width < imageWidth) ? xOffset + width + 1 : imageWidth;
+	int frameBottom = (yOffset + height < imageHeight) ? yOffset + height + 1 : imageHeight;
+	int frameWidth = frameRight - frameLeft;
+	int frameHeight = frameBottom - frameTop;
+
+	StagedFrame* frame = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		unsigned long long index = frameIndex++;
+		size_t rowSize = (size_t)frameWidth * bytesPerPixel;
+		if (stagedCount < StagingFrameCount && frameWidth > 0 && frameHeight > 0 && rowSize * frameHeight <= staged[0].pixels.size()) {
+			frame = &staged[(stagedFirst + stagedCount) % StagingFrameCount];
+			frame->header.frameIndex = index;
+		} else {
+			droppedCount++;
+			return;
+		}
+	}
+
+	// Only this thread touches frames past the staged ones, so the copy doesn't need the lock
+	std::chrono::microseconds now = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch());
+	frame->header.timestamp = now.count();
+	frame->header.isLEDOn = isLEDOn;
+	frame->header.width = width;
+	frame->header.height = height;
+	frame->header.xOffset = xOffset;
+	frame->header.yOffset = yOffset;
+	frame->header.frameWidth = frameWidth;
+	frame->header.frameHeight = frameHeight;
+	frame->header.borderLeft = xOffset - frameLeft;
+	frame->header.borderTop = yOffset - frameTop;
+	frame->header.pitch = frameWidth * bytesPerPixel;
+	for (int Y = 0; Y < frameHeight; Y++) {
+		memcpy(&frame->pixels[(size_t)Y * frame->header.pitch], pMem + (size_t)(frameTop + Y) * pitch + frameLeft * bytesPerPixel, frame->header.pitch);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stagedCount++;
+	}
+	framesReady.notify_one();
+}
+
+// Frames given to record() since recording started (including dropped ones)
+unsigned long long FrameRecorder::framesRecorded()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return frameIndex;
+}
+
+// Frames dropped because the writer fell behind
+unsigned long long FrameRecorder::framesDropped()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return droppedCount;
+}
+
+// Writer thread loop, copies staged frames into their slots
+void FrameRecorder::write()
+{
+	RecordingHeader* header = reinterpret_cast<RecordingHeader*>(mapping);
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		while (!stopping && stagedCount == 0) {
+			framesReady.wait(guard);
+		}
+		if (stagedCount == 0) return; // (Only when stopping, once everything is written)
+
+		StagedFrame& frame = staged[stagedFirst];
+		guard.unlock();
+
+		char* slot = mapping + RecordingPageSize + (frame.header.frameIndex % header->slotCount) * slotSize;
+		memcpy(slot + sizeof(RecordedFrameHeader), frame.pixels.data(), (size_t)frame.header.pitch * frame.header.frameHeight);
+		memcpy(slot, &frame.header, sizeof(RecordedFrameHeader));
+		header->framesWritten = frame.header.frameIndex + 1;
+
+		guard.lock();
+		stagedFirst = (stagedFirst + 1) % StagingFrameCount;
+		stagedCount--;
+	}
+}
+
+// Make the file (fileSize bytes) and map it into memory
+bool FrameRecorder::mapFile(const std::string& path)
+{
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) return false;
+	// (Mapping sets the file size)
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)fileSize >> 32), (DWORD)(fileSize & 0xFFFFFFFF), NULL);
+	if (mappingHandle != NULL) {
+		mapping = reinterpret_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, fileSize));
+	}
+#else
+	fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fileDescriptor < 0) return false;
+	if (ftruncate(fileDescriptor, fileSize) == 0) {
+		void* address = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+		if (address != MAP_FAILED) {
+			mapping = reinterpret_cast<char*>(address);
+		}
+	}
+#endif
+	if (mapping == nullptr) {
+		unmapFile();
+		return false;
+	}
+	return true;
+}
+
+// Flush the mapped file to disk and close it
+void FrameRecorder::unmapFile()
+{
+#ifdef _WIN32
+	if (mapping != nullptr) {
+		FlushViewOfFile(mapping, 0);
+		UnmapViewOfFile(mapping);
+	}
+	if (mappingHandle != NULL) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (mapping != nullptr) {
+		msync(mapping, fileSize, MS_SYNC);
+		munmap(mapping, fileSize);
+	}
+	if (fileDescriptor >= 0) close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapping = nullptr;
+}
@@ -0,0 +1,162 @@
+#include <vector>
+
+/*
+
+RegionTable keeps everything known about each region label in one place:
+	which label it is equivalent to, and the sums needed for its center of mass
+Each label's entry is one small struct, so labeling a pixel touches one cache line
+Each entry also keeps the exact bounding box of its pixels, so that a region's
+	pixels can be looked at without scanning a guessed window around it
+
+Labels are equivalent when they belong to the same spot, which is tracked
+	as a flat disjoint-set (union-find) table
+Label 0 is reserved for unlit pixels, a label must be made its own set with
+	makeSet() before it is used (which also clears its sums)
+Sets are joined by rank (so trees stay shallow) and find() compresses paths
+	as it goes, so each lookup costs effectively constant time
+flatten() points every label directly at its root once labeling is done,
+	after which parent is the final region of that label
+
+The table is reused from image to image, and only grows (see grow()) when
+	an image has more labels than fit
+
+*/
+
+// Entry of a single region label
+struct Region
+{
+	unsigned int parent;		// Label this label points to (roots point to themselves)
+	unsigned int rank;			// Upper bound on the height of this root's tree
+	unsigned long long xSum;	// Sum of X * pixel intensity
+	unsigned long long ySum;	// Sum of Y * pixel intensity
+	unsigned long long intensity;	// Sum of pixel intensities (64-bit so 16-bit pixels can't overflow)
+	unsigned int pixelCount;	// Number of pixels
+	unsigned int xMin;			// Bounding box of the region's pixels (inclusive)
+	unsigned int xMax;
+	unsigned int yMin;
+	unsigned int yMax;
+	unsigned int firstRun;		// Index of the region's first run in the list of runs grouped by region
+	unsigned int runCount;		// Number of runs in the region (only kept for regions HGCM looks at)
+};
+
+class RegionTable
+{
+public:
+	std::vector<Region> entries;	// Entry of each label
+	int resizeCount = 0;			// Number of times the table had to grow
+
+	void assign(unsigned int size);
+	unsigned int size();
+	void grow();
+	Region& operator[](unsigned int label);
+	void makeSet(unsigned int label);
+	unsigned int find(unsigned int label);
+	unsigned int unite(unsigned int a, unsigned int b);
+	void extendBox(Region& region, unsigned int xFirst, unsigned int xLast, unsigned int Y);
+	void mergeBox(Region& region, Region& other);
+	void flatten(unsigned int lastLabel);
+};
+
+// Allocate space for (size - 1) labels
+void RegionTable::assign(unsigned int size)
+{
+	Region empty = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	entries.assign(size, empty);
+}
+
+// Total number of labels that can be stored (including label 0)
+unsigned int RegionTable::size()
+{
+	return entries.size();
+}
+
+// Double the number of labels that can be stored
+void RegionTable::grow()
+{
+	Region empty = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	unsigned int newSize = 2 * entries.size();
+	if (newSize < 16) newSize = 16;
+	entries.resize(newSize, empty);
+	resizeCount++;
+}
+
+// Entry of label
+Region& RegionTable::operator[](unsigned int label)
+{
+	return entries[label];
+}
+
+// Make label an empty region of its own
+void RegionTable::makeSet(unsigned int label)
+{
+	Region& region = entries[label];
+	region.parent = label;
+	region.rank = 0;
+	region.xSum = 0;
+	region.ySum = 0;
+	region.intensity = 0;
+	region.pixelCount = 0;
+	region.xMin = 0xFFFFFFFF; // Empty box, the first pixel added sets it
+	region.xMax = 0;
+	region.yMin = 0xFFFFFFFF;
+	region.yMax = 0;
+	region.firstRun = 0;
+	region.runCount = 0;
+}
+
+// Find the root label of a label's set
+unsigned int RegionTable::find(unsigned int label)
+{
+	// Path halving: point every other label on the way up to its grandparent
+	while (entries[label].parent != label) {
+		entries[label].parent = entries[entries[label].parent].parent;
+		label = entries[label].parent;
+	}
+	return label;
+}
+
+// Join the sets of two labels and return the new root
+unsigned int RegionTable::unite(unsigned int a, unsigned int b)
+{
+	unsigned int aRoot = find(a);
+	unsigned int bRoot = find(b);
+	if (aRoot == bRoot) {
+		return aRoot;
+	}
+	// Attach the shorter tree below the taller one
+	if (entries[aRoot].rank < entries[bRoot].rank) {
+		entries[aRoot].parent = bRoot;
+		return bRoot;
+	}
+	if (entries[aRoot].rank == entries[bRoot].rank) {
+		entries[aRoot].rank++;
+	}
+	entries[bRoot].parent = aRoot;
+	return aRoot;
+}
+
+// Grow a region's bounding box to include pixels xFirst ... xLast of row Y
+void RegionTable::extendBox(Region& region, unsigned int xFirst, unsigned int xLast, unsigned int Y)
+{
+	if (xFirst < region.xMin) region.xMin = xFirst;
+	if (xLast > region.xMax) region.xMax = xLast;
+	if (Y < region.yMin) region.yMin = Y;
+	if (Y > region.yMax) region.yMax = Y;
+}
+
+// Grow a region's bounding box to include another region's bounding box
+void RegionTable::mergeBox(Region& region, Region& other)
+{
+	if (other.xMin < region.xMin) region.xMin = other.xMin;
+	if (other.xMax > region.xMax) region.xMax = other.xMax;
+	if (other.yMin < region.yMin) region.yMin = other.yMin;
+	if (other.yMax > region.yMax) region.yMax = other.yMax;
+}
+
+// Point every label up to lastLabel directly at its root
+void RegionTable::flatten(unsigned int lastLabel)
+{
+	for (unsigned int label = 1; label <= lastLabel; label++) {
+		entries[label].parent = find(label);
+	}
+}
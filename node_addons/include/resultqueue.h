@@ -0,0 +1,165 @@
+#include <mutex>
+#include <vector>
+
+/*
+
+ResultQueue passes centroiding results from the acquisition thread to the
+	JavaScript thread
+
+Each FrameResult is a copy of everything sendCentroids() sends for one frame,
+	so the acquisition thread can go on to the next frame while JavaScript
+	still has the last one
+The centroids of both methods are packed into one array of floats, which
+	sendCentroids() copies into a Float32Array with a single memcpy:
+		CentroidHeaderSize header values (FloatsPerCentroid, CoM count, HGCM count, 0)
+		X, Y, average pixel intensity of each CoM centroid (in AoI coordinates)
+		X, Y, average pixel intensity of each HGCM centroid
+The queue has ResultQueueSize preallocated results, and if JavaScript falls
+	that far behind, new results are dropped (and counted) rather than ever
+	making the acquisition thread wait
+
+Producer: reserve() a result, fill it, then publish() it
+Consumer: front() is the oldest published result, pop() it when done
+
+Frames only have a preview image when PreviewStage (previewstage.h) made one
+	of them (at most a few times a second), and only then is it copied
+
+(centroid.h and previewstage.h have to be included before this file)
+
+*/
+
+const int ResultQueueSize = 4;
+const int CentroidHeaderSize = 4;	// Values before the first centroid in FrameResult::centroids
+const int FloatsPerCentroid = 3;	// X, Y, average pixel intensity
+
+// Centroiding results of one frame
+struct FrameResult
+{
+	std::vector<float> centroids;		// Header, then the CoM centroids, then the HGCM centroids (packed)
+	int CoMCount;
+	int HGCMCount;
+	float computationTime;
+	bool isLEDOn;
+	float avgLEDIntensity;
+	float avgNoiseIntensity;
+	int regionTableResizes;
+	bool hasPreview = false;			// Whether a preview image was made of this frame
+	int previewWidth;
+	int previewHeight;
+	int previewScale;					// Image pixels per preview pixel, each way
+	std::vector<unsigned char> buffer;	// Preview image (RGBA)
+	unsigned long long frameNumber;		// Camera's number for the frame (set by the caller)
+
+	void copy(Centroid& img, std::vector<unsigned char>& imageBuffer, PreviewStage& previewStage);
+};
+
+// Copy the results of the image img just centroided
+// (imageBuffer is the preview previewStage made of it, if any)
+void FrameResult::copy(Centroid& img, std::vector<unsigned char>& imageBuffer, PreviewStage& previewStage)
+{
+	CoMCount = img.CCLCount;
+	HGCMCount = img.HybridCount;
+	centroids.resize(CentroidHeaderSize + FloatsPerCentroid * (CoMCount + HGCMCount)); // (Only allocates if there are more centroids than ever before)
+	centroids[0] = FloatsPerCentroid;
+	centroids[1] = CoMCount;
+	centroids[2] = HGCMCount;
+	centroids[3] = 0;
+	float* centers = &centroids[CentroidHeaderSize];
+	for (int method = 0; method < 2; method++) {
+		int count = (method == 0) ? CoMCount : HGCMCount;
+		for (int center = 0; center < count; center++) {
+			// Account for offsets
+			centers[0] = img.Centroids(method, center, 0) - img.xLowerBound;
+			centers[1] = img.Centroids(method, center, 1) - img.yLowerBound;
+			centers[2] = img.Centroids(method, center, 2);
+			centers += FloatsPerCentroid;
+		}
+	}
+	computationTime = img.computationTime;
+	isLEDOn = img.isLEDon;
+	avgLEDIntensity = img.LEDIntensity / img.LEDCount;
+	avgNoiseIntensity = img.NoiseIntensity / img.NoiseCount;
+	regionTableResizes = img.RegionData.resizeCount;
+	hasPreview = previewStage.take();
+	if (hasPreview) {
+		previewWidth = previewStage.width;
+		previewHeight = previewStage.height;
+		previewScale = previewStage.renderedScale;
+		buffer.assign(imageBuffer.begin(), imageBuffer.end()); // (Only allocates if the preview size changed)
+	}
+}
+
+class ResultQueue
+{
+public:
+	FrameResult* reserve();
+	void publish();
+	FrameResult* front();
+	void pop();
+	unsigned long long resultCount();
+	unsigned long long droppedCount();
+
+private:
+	FrameResult results[ResultQueueSize];
+	std::mutex lock;
+	int first = 0;			// Oldest published result
+	int count = 0;			// Published results JavaScript hasn't finished with
+	bool reserved = false;	// Whether the producer is filling the result after the published ones
+	unsigned long long published = 0;	// Results published since startup
+	unsigned long long dropped = 0;		// Results dropped because the queue was full
+};
+
+// Result to fill for a new frame, or nullptr if the queue is full (the result is dropped)
+// (Only the producer thread may call this)
+FrameResult* ResultQueue::reserve()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (count == ResultQueueSize) {
+		dropped++;
+		return nullptr;
+	}
+	reserved = true;
+	return &results[(first + count) % ResultQueueSize];
+}
+
+// Hand the reserved result to the consumer
+void ResultQueue::publish()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (!reserved) return;
+	reserved = false;
+	count++;
+	published++;
+}
+
+// Oldest published result, or nullptr if there are none
+// (Only the consumer thread may call this, and the result stays valid until pop())
+FrameResult* ResultQueue::front()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (count == 0) return nullptr;
+	return &results[first];
+}
+
+// Done with the oldest result
+void ResultQueue::pop()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (count == 0) return;
+	first = (first + 1) % ResultQueueSize;
+	count--;
+}
+
+// Results published since startup
+unsigned long long ResultQueue::resultCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return published;
+}
+
+// Results dropped since startup because JavaScript fell behind
+unsigned long long ResultQueue::droppedCount()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return dropped;
+}
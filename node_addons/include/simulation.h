@@ -0,0 +1,157 @@
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+
+/*
+
+ImageSimulator makes fake 8-bit VMI camera images (noise, electron spots, and the IR LED)
+
+Used by camera_mac.cc as a stand-in for the camera, and by the centroiding
+	benchmark so that it can run without Electron or a camera
+Spots are scattered around the center of the centroiding AoI on rings of
+	the given radii (chosen with the given weights), and "IR on" and "IR off"
+	images alternate, each with their own radii
+The LED and AoI areas are taken from the Centroid object the images are for
+	(so centroid.h has to be included before this file)
+The exact center of every spot of the last image is kept in spotCenters,
+	so centroiding results can be checked against the truth
+
+*/
+
+// Spot added to a simulated image
+struct SimulatedSpot
+{
+	float X;			// True center of the spot
+	float Y;
+	float intensity;	// Fraction of full intensity (0.5 - 1.1)
+};
+
+class ImageSimulator
+{
+public:
+	bool isIROn = false;					// Add in ability to make "IR On" images different
+	bool useLED = true;						// Whether to add in intensity to simulate IR LED
+	int baseNumberOfSpots = 55;				// Base number of electron spots to add to simulated image
+	int numberOfSpotsVariation = 10;		// Variation of the number of electron spots
+	std::vector<float> IROffRadii = {50, 90, 170, 300};
+	std::vector<float> IROffWeights = {2, 4, 3, 1};
+	std::vector<float> IROnRadii = {50, 90, 120, 170, 300};
+	std::vector<float> IROnWeights = {2, 3, 2, 2, 1};
+	std::vector<SimulatedSpot> spotCenters;	// Spots of the last simulated image
+
+	void simulateImage(std::vector<char>& simImage, unsigned int randSeed, int width, int height, Centroid& img);
+
+private:
+	float gauss(int i, float center, float width);
+};
+
+float ImageSimulator::gauss(int i, float center, float width)
+{
+	return sqrt(255) * exp(-pow(i - center, 2) / width);
+}
+
+// Fill simImage (width x height pixels, 1 byte each) with a new simulated image
+void ImageSimulator::simulateImage(std::vector<char>& simImage, unsigned int randSeed, int width, int height, Centroid& img)
+{
+	float const pi = 3.14159265358979;
+	srand(randSeed); // Setting up random number generator
+
+	// Simulated values
+	int numberOfSpots = (rand() % numberOfSpotsVariation) + baseNumberOfSpots;
+	spotCenters.clear();
+	//std::vector<float> Radii = {30, 50, 90, 120, 170};
+	std::vector<float> Radii = IROffRadii;
+	std::vector<float> PeakWeights = IROffWeights;
+
+	// First clear the image (i.e. fill with 0's)
+	// 		(Unnecessary if adding noise)
+	//std::fill(std::begin(simImage), std::end(simImage), 0);
+
+	// Get center of image
+	//int imageCenterX = width / 2;
+	//int imageCenterY = height / 2;
+	int imageCenterX = img.xLowerBound + (img.xUpperBound - img.xLowerBound) / 2;
+	int imageCenterY = img.yLowerBound + (img.yUpperBound - img.yLowerBound) / 2;
+
+
+	// Add noise to the image
+	for (int i = 0; i < width * height;  i++) {
+		int noise = rand() % 5;
+		simImage[i] = (char)noise;
+	}
+
+	// Add in intensity to simulate IR LED
+	if (isIROn && useLED) {
+		for (int Y = img.LEDyLowerBound; Y < img.LEDyUpperBound; Y++) {
+			for (int X = img.LEDxLowerBound; X < img.LEDxUpperBound; X++) {
+				int intensity = rand() % 40 + 80;
+				simImage[width * Y + X] = intensity;
+			}
+		}
+	}
+
+	if (isIROn) {
+		isIROn = false;
+		Radii = IROnRadii;
+		PeakWeights = IROnWeights;
+		//return;
+	} else {
+		isIROn = true;
+	}
+
+	int PeakWeightSum = 0;
+	for (int i = 0; i < PeakWeights.size(); i++) {
+		PeakWeightSum += PeakWeights[i];
+	}
+
+	// Add spots
+	int spotNumber = 0;
+	while (spotNumber < numberOfSpots)
+	{
+		// If sum of peak weights is <= 0, don't add any spots to image
+		if (PeakWeightSum <= 0) {
+			break;
+		}
+		int radiusProbability = (rand() % (1000*PeakWeightSum-1)) / 1000;
+		int radiusIndex = -1;
+		int weightSum = 0;
+		while (radiusProbability >= weightSum) {
+			radiusIndex++;
+			weightSum += PeakWeights[radiusIndex];
+		}
+		float radius = Radii[radiusIndex];
+
+		// Using the physics def. of spherical coords
+		float phi = 2 * pi * ((rand() % RAND_MAX) / (1.0 * RAND_MAX)); 			// (0, 2pi)
+		float costheta = 2.0 * ((rand() % RAND_MAX) / (1.0 * RAND_MAX)) - 1.0; 	// (-1, 1)
+		float theta = acos(costheta);
+		float centerX = imageCenterX + radius * sin(theta) * cos(phi); // Converting to Cartesian coords
+		float centerY = imageCenterY + radius * cos(theta);
+		float widthX = (rand() % 50 + 100) / 10.0; // Randomly chooses widths btw 10.0 and 15.0 pixels (closer to real spot sizes)
+		float widthY = (rand() % 50 + 100) / 10.0;
+		float percentIntensity = (rand() % 60 + 50) / 100.0; // Choosing intensity btw 50% and 110%
+		SimulatedSpot spot = { centerX, centerY, percentIntensity };
+		spotCenters.push_back(spot);
+
+		// Add the spot to the image
+		for (int Y = centerY - 8; Y < centerY + 9; Y++)
+		{
+			for (int X = centerX - 8; X < centerX + 9; X++)
+			{
+				// Parts of spots that fall off the image are cut off
+				if (X < 0 || X >= width || Y < 0 || Y >= height) continue;
+				int intensity = round(gauss(Y, centerY, widthY) * gauss(X, centerX, widthX) * percentIntensity);
+				int currentIntensity = (unsigned char)simImage[width * Y + X];
+				currentIntensity += intensity;
+				if (currentIntensity > 255)
+				{
+					currentIntensity = 255; // Cuts off intensity at 255
+				}
+				simImage[width * Y + X] = currentIntensity;
+			}
+		}
+
+		spotNumber++;
+
+	}
+}
@@ -0,0 +1,138 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+/*
+
+ThreadPool keeps a set of worker threads alive between images so that
+splitting an image into parallel jobs doesn't cost a thread launch per image
+
+setThreadCount(n) sets the number of threads working on each job, including
+	the calling thread (so n = 1 means everything runs on the calling thread)
+run(taskCount, task, context) calls task(context, i) for i = 0 ... taskCount-1
+	spread over the threads, and returns once every task has finished
+
+*/
+
+class ThreadPool
+{
+public:
+	ThreadPool();
+	~ThreadPool();
+	void setThreadCount(int count);
+	int threadCount();
+	void run(int count, void (*task)(void*, int), void* context);
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable tasksReady;		// Signals workers that there are new tasks (or to stop)
+	std::condition_variable tasksDone;		// Signals run() that the last task finished
+
+	void (*currentTask)(void*, int) = nullptr;
+	void* currentContext = nullptr;
+	int taskCount = 0;		// Number of tasks in current job
+	int nextTask = 0;		// Next task to be picked up
+	int tasksRemaining = 0;	// Tasks that haven't finished yet
+	bool stopping = false;	// Whether workers should exit
+
+	void work();
+	void runTasks(std::unique_lock<std::mutex>& guard);
+	void stopWorkers();
+};
+
+ThreadPool::ThreadPool()
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+// Set the number of threads (including the calling thread) that work on each job
+void ThreadPool::setThreadCount(int count)
+{
+	if (count < 1) count = 1;
+	if (count == threadCount()) return;
+
+	stopWorkers();
+	stopping = false;
+	for (int i = 0; i < count - 1; i++) {
+		workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+// Number of threads (including the calling thread) that work on each job
+int ThreadPool::threadCount()
+{
+	return workers.size() + 1;
+}
+
+// Run task(context, i) for i = 0 ... count-1 and wait for all of them to finish
+void ThreadPool::run(int count, void (*task)(void*, int), void* context)
+{
+	if (workers.empty()) {
+		for (int i = 0; i < count; i++) {
+			task(context, i);
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> guard(lock);
+	currentTask = task;
+	currentContext = context;
+	taskCount = count;
+	nextTask = 0;
+	tasksRemaining = count;
+	tasksReady.notify_all();
+
+	// Calling thread helps out instead of sitting idle
+	runTasks(guard);
+	while (tasksRemaining > 0) {
+		tasksDone.wait(guard);
+	}
+}
+
+// Pick up tasks until there are none left (lock must be held)
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& guard)
+{
+	while (nextTask < taskCount) {
+		int task = nextTask++;
+		guard.unlock();
+		currentTask(currentContext, task);
+		guard.lock();
+		tasksRemaining--;
+		if (tasksRemaining == 0) {
+			tasksDone.notify_all();
+		}
+	}
+}
+
+// Worker thread loop
+void ThreadPool::work()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		while (!stopping && nextTask >= taskCount) {
+			tasksReady.wait(guard);
+		}
+		if (stopping) return;
+		runTasks(guard);
+	}
+}
+
+// Stop and join all worker threads
+void ThreadPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	tasksReady.notify_all();
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <math.h>
+
+/*
+
+TriggerSchedule gives the time of each trigger of a simulated camera
+
+Triggers come every period ms, each moved by a random amount up to jitter ms
+	earlier or later (jitter is kept under half the period, so triggers stay in
+	order)
+With burstLength > 0, triggers come in bursts of burstLength triggers, with an
+	extra burstPause ms after each burst
+Trigger times are counted from start(), so changing the settings and calling
+	start() again with the next trigger number starts the new pattern from now
+The jitter of trigger n only depends on n, so the same schedule always gives
+	the same times
+
+(fastsimulation.h has to be included before this file, for CounterRandom)
+
+*/
+
+class TriggerSchedule
+{
+public:
+	double period = 50;		// ms between triggers
+	double jitter = 0;		// Most a trigger is moved from its place (ms)
+	int burstLength = 0;	// Triggers per burst (0 means no bursts)
+	double burstPause = 0;	// Extra ms after each burst
+
+	void start(unsigned long long firstTrigger);
+	double now();
+	double time(unsigned long long trigger);
+	unsigned long long nextTrigger(double time);
+
+private:
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	unsigned long long first = 0;		// Trigger at startTime (without jitter)
+
+	double jitterUsed();
+	double baseTime(unsigned long long index);
+};
+
+// Start the schedule now, with trigger firstTrigger
+void TriggerSchedule::start(unsigned long long firstTrigger)
+{
+	startTime = std::chrono::steady_clock::now();
+	first = firstTrigger;
+}
+
+// ms since start()
+double TriggerSchedule::now()
+{
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+	return elapsed.count();
+}
+
+// Jitter, kept under half the period
+double TriggerSchedule::jitterUsed()
+{
+	return (jitter < 0.49 * period) ? jitter : 0.49 * period;
+}
+
+// Time of trigger number index after the first one, without jitter
+double TriggerSchedule::baseTime(unsigned long long index)
+{
+	if (burstLength > 0) {
+		return (index / burstLength) * (burstLength * period + burstPause) + (index % burstLength) * period;
+	}
+	return index * period;
+}
+
+// Time of trigger number trigger (ms since start(), triggers before firstTrigger are at 0)
+double TriggerSchedule::time(unsigned long long trigger)
+{
+	if (trigger < first) return 0;
+	double time = baseTime(trigger - first);
+	if (jitter > 0) {
+		CounterRandom random(trigger, 3);
+		time += jitterUsed() * (2 * random.uniform() - 1);
+	}
+	return (time > 0) ? time : 0;
+}
+
+// Number of the first trigger after time (ms since start())
+unsigned long long TriggerSchedule::nextTrigger(double time)
+{
+	if (period <= 0) return first;
+	// Triggers whose base time is before time - jitter are certainly before time
+	double earliest = time - jitterUsed();
+	unsigned long long trigger = first;
+	if (earliest >= 0) {
+		if (burstLength > 0) {
+			double cycle = burstLength * period + burstPause;
+			unsigned long long cycles = (unsigned long long)(earliest / cycle);
+			unsigned long long inBurst = (unsigned long long)((earliest - cycles * cycle) / period) + 1;
+			trigger += cycles * burstLength + ((inBurst < burstLength) ? inBurst : burstLength);
+		} else {
+			trigger += (unsigned long long)(earliest / period) + 1;
+		}
+	}
+	// The next few may be before time too, depending on their jitter
+	while (this->time(trigger) <= time) {
+		trigger++;
+	}
+	return trigger;
+}
@@ -0,0 +1,157 @@
+#include "centroid.h"
+#include "recorder.h"
+#include "accumulatedimage.h"
+#include "recentroid.h"
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+
+Centroid a recording (made with camera.startRecording()) again with new settings
+	(built as its own executable by binding.gyp, camera.recentroidRecording() does the same from JS)
+
+For each threshold, writes
+	PREFIX_tN.i0N			IR off accumulated image (same format as ImageClasses.js saves)
+	PREFIX_tN_IR.i0N		IR on accumulated image
+	PREFIX_tN_centroids.csv	Every centroid (frame index, LED state, method, X, Y, intensity)
+and prints one line of JSON with the number of frames and electrons
+
+Usage: recentroid FILE [options]
+	--thresholds N[,N...]	Thresholds to try (default 20), all done in one pass over the file
+	--min-pix N				Smallest region to centroid (default 3)
+	--max-pix N				Regions with this many pixels use HGCM (default 120)
+	--method M				com or hgcm (default hgcm)
+	--threads N				Number of threads (default every core)
+	--bin-size N			Size of the accumulated images (default 1024)
+	--output PREFIX			Start of the output file names (default FILE without extension)
+	--no-centroids			Don't write the centroid lists
+
+*/
+
+struct RecentroidOptions
+{
+	std::string path;
+	std::string outputPrefix;
+	bool writeCentroids = true;
+};
+
+// Read command line options into settings
+// Returns false if an option isn't recognized
+bool parseArguments(int argc, char** argv, RecentroidSettings& settings, RecentroidOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (option == "--thresholds" && hasValue) {
+			// Comma separated list
+			settings.thresholds.clear();
+			char* list = argv[++i];
+			while (*list != '\0') {
+				settings.thresholds.push_back(strtoul(list, &list, 10));
+				if (*list == ',') list++;
+				else if (*list != '\0') return false;
+			}
+		} else if (option == "--min-pix" && hasValue) {
+			settings.minPix = atoi(argv[++i]);
+		} else if (option == "--max-pix" && hasValue) {
+			settings.maxPix = atoi(argv[++i]);
+		} else if (option == "--method" && hasValue) {
+			std::string method = argv[++i];
+			if (method != "com" && method != "hgcm") return false;
+			settings.useHybrid = (method == "hgcm");
+		} else if (option == "--threads" && hasValue) {
+			settings.threads = atoi(argv[++i]);
+		} else if (option == "--bin-size" && hasValue) {
+			settings.binSize = atoi(argv[++i]);
+		} else if (option == "--output" && hasValue) {
+			options.outputPrefix = argv[++i];
+		} else if (option == "--no-centroids") {
+			options.writeCentroids = false;
+		} else if (options.path.empty() && option[0] != '-') {
+			options.path = option;
+		} else {
+			return false;
+		}
+	}
+	if (options.outputPrefix.empty()) {
+		options.outputPrefix = options.path.substr(0, options.path.find_last_of('.'));
+	}
+	return !options.path.empty() && !settings.thresholds.empty() && settings.binSize > 0;
+}
+
+// Save an accumulated image as rows of space separated counts
+bool saveImage(const std::string& fileName, std::vector<unsigned int>& image, int binSize)
+{
+	FILE* file = fopen(fileName.c_str(), "w");
+	if (!file) return false;
+	for (int Y = 0; Y < binSize; Y++) {
+		for (int X = 0; X < binSize; X++) {
+			fprintf(file, (X == 0) ? "%u" : " %u", image[binSize * Y + X]);
+		}
+		if (Y < binSize - 1) fputc('\n', file);
+	}
+	fclose(file);
+	return true;
+}
+
+// Save every centroid of a result
+bool saveCentroids(const std::string& fileName, RecordingReader& recording, Recentroider& recentroider, RecentroidResult& result)
+{
+	FILE* file = fopen(fileName.c_str(), "w");
+	if (!file) return false;
+	fprintf(file, "frame_index,is_led_on,method,x,y,intensity\n");
+	for (int frame = 0; frame < recording.frameCount(); frame++) {
+		unsigned long long frameIndex = recording.frameHeader(frame).frameIndex;
+		for (unsigned int i = result.frameStart[frame]; i < result.frameStart[frame + 1]; i++) {
+			RecentroidedSpot& spot = result.centroids[i];
+			fprintf(file, "%llu,%d,%s,%.3f,%.3f,%.2f\n", frameIndex, (int)recentroider.frameLEDOn[frame],
+				spot.method ? "hgcm" : "com", spot.X, spot.Y, spot.intensity);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Recentroider recentroider;
+	RecentroidOptions options;
+	if (!parseArguments(argc, argv, recentroider.settings, options)) {
+		fprintf(stderr, "Usage: recentroid FILE [options], see the top of recentroid.cc\n");
+		return 1;
+	}
+
+	RecordingReader recording;
+	if (!recording.open(options.path)) {
+		fprintf(stderr, "Could not read recording %s\n", options.path.c_str());
+		return 1;
+	}
+
+	recentroider.run(recording);
+
+	int frames = recording.frameCount();
+	int binSize = recentroider.settings.binSize;
+	for (int t = 0; t < recentroider.results.size(); t++) {
+		RecentroidResult& result = recentroider.results[t];
+		std::string prefix = options.outputPrefix + "_t" + std::to_string(result.threshold);
+		bool saved = saveImage(prefix + ".i0N", result.IROffImage, binSize)
+			&& saveImage(prefix + "_IR.i0N", result.IROnImage, binSize);
+		if (options.writeCentroids) {
+			saved = saved && saveCentroids(prefix + "_centroids.csv", recording, recentroider, result);
+		}
+		if (!saved) {
+			fprintf(stderr, "Could not save results to %s\n", prefix.c_str());
+			return 1;
+		}
+
+		printf("{\"threshold\": %u, \"frames\": %d, \"ir_off_electrons\": %llu, \"ir_on_electrons\": %llu, "
+			"\"electrons_per_frame\": %.2f, \"output\": \"%s\"}\n",
+			result.threshold, frames, result.IROffCount, result.IROnCount,
+			frames ? (result.IROffCount + result.IROnCount) / (double)frames : 0, prefix.c_str());
+	}
+	fprintf(stderr, "Centroided %d frames with %d thresholds in %.1f s\n", frames,
+		(int)recentroider.results.size(), recentroider.computationTime / 1000);
+
+	return 0;
+}